@@ -0,0 +1,208 @@
+#include"BTAdaptive.h"
+#include"BTLog.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+
+namespace
+{
+	// Order key of a child: the expected cost to spend on it per success
+	double OrderKey(double mean_cost_ns, double success_rate, unsigned long long ticks)
+	{
+		if (ticks == 0)
+		{
+			// not measured yet: tried first
+			return -1.0;
+		}
+		return mean_cost_ns / std::max(success_rate, 1e-3);
+	}
+}
+
+
+BT::AdaptiveSelectorNode::AdaptiveSelectorNode(std::string name) : ControlNode::ControlNode(name),
+	reorder_period_(16), ticks_since_reorder_(0), window_(64), reorders_(0) {}
+BT::AdaptiveSelectorNode::~AdaptiveSelectorNode() {}
+int BT::AdaptiveSelectorNode::DrawType()
+{
+	return BT::SELECTOR;
+}
+void BT::AdaptiveSelectorNode::AddChild(TreeNode* child)
+{
+	InsertChild(child, true);
+}
+void BT::AdaptiveSelectorNode::AddFixedChild(TreeNode* child)
+{
+	InsertChild(child, false);
+}
+void BT::AdaptiveSelectorNode::InsertChild(TreeNode* child, bool is_reorderable)
+{
+	ControlNode::AddChild(child);
+	ChildStatistics statistics = ChildStatistics();
+	statistics.is_reorderable = is_reorderable;
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	statistics_.push_back(statistics);
+}
+BT::ReturnStatus BT::AdaptiveSelectorNode::Tick()
+{
+	N_of_children_ = children_nodes_.size();
+
+	// A running child keeps its place until the selector returns
+	ticks_since_reorder_++;
+	if (ticks_since_reorder_ >= reorder_period_ && get_status() != BT::RUNNING)
+	{
+		Reorder();
+		ticks_since_reorder_ = 0;
+	}
+
+	// Routing the ticks according to the fallback node's logic, measuring every child
+	for (unsigned int i = 0; i < N_of_children_; i++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		child_i_status_ = TickChild(i);
+		Record(i, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(), child_i_status_ != BT::FAILURE);
+
+		if (child_i_status_ != BT::FAILURE)
+		{
+			if (child_i_status_ == BT::SUCCESS)
+			{
+				children_nodes_[i]->set_status(BT::IDLE);
+			}
+			BT_LOG_DEBUG(get_name().data(), "is HALTING children from %u", i + 1);
+			HaltChildren(i + 1);
+			set_status(child_i_status_);
+			return child_i_status_;
+		}
+
+		children_nodes_[i]->set_status(BT::IDLE);
+		if (i == N_of_children_ - 1)
+		{
+			set_status(BT::FAILURE);
+			return BT::FAILURE;
+		}
+	}
+	return BT::EXIT;
+}
+void BT::AdaptiveSelectorNode::Record(unsigned int i, double cost_ns, bool is_success)
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	ChildStatistics& statistics = statistics_[i];
+
+	// Running averages over the first window ticks, then exponential ones
+	statistics.ticks++;
+	double weight = 1.0 / std::min<unsigned long long>(statistics.ticks, window_);
+	statistics.mean_cost_ns += (cost_ns - statistics.mean_cost_ns) * weight;
+	statistics.success_rate += ((is_success ? 1.0 : 0.0) - statistics.success_rate) * weight;
+}
+void BT::AdaptiveSelectorNode::Reorder()
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	std::vector<unsigned int> order(children_nodes_.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+
+	// Sorts each run of reorderable children between two fixed ones
+	unsigned int begin = 0;
+	while (begin < order.size())
+	{
+		if (!statistics_[begin].is_reorderable)
+		{
+			begin++;
+			continue;
+		}
+		unsigned int end = begin;
+		while (end < order.size() && statistics_[end].is_reorderable)
+		{
+			end++;
+		}
+		std::stable_sort(order.begin() + begin, order.begin() + end, [this](unsigned int a, unsigned int b)
+		{
+			return OrderKey(statistics_[a].mean_cost_ns, statistics_[a].success_rate, statistics_[a].ticks)
+				< OrderKey(statistics_[b].mean_cost_ns, statistics_[b].success_rate, statistics_[b].ticks);
+		});
+		begin = end;
+	}
+
+	bool is_changed = false;
+	for (unsigned int i = 0; i < order.size() && !is_changed; i++)
+	{
+		is_changed = (order[i] != i);
+	}
+	if (!is_changed)
+	{
+		return;
+	}
+
+	std::vector<TreeNode*> children_nodes(order.size());
+	std::vector<ReturnStatus> children_states(order.size());
+	std::vector<ChildStatistics> statistics(order.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		children_nodes[i] = children_nodes_[order[i]];
+		children_states[i] = children_states_[order[i]];
+		statistics[i] = statistics_[order[i]];
+	}
+	children_nodes_.swap(children_nodes);
+	children_states_.swap(children_states);
+	statistics_.swap(statistics);
+	reorders_++;
+}
+void BT::AdaptiveSelectorNode::set_reorder_period(unsigned int reorder_period)
+{
+	if (reorder_period == 0)
+	{
+		throw std::invalid_argument("the reorder period of an adaptive selector must be positive");
+	}
+	reorder_period_ = reorder_period;
+}
+unsigned int BT::AdaptiveSelectorNode::get_reorder_period()
+{
+	return reorder_period_;
+}
+void BT::AdaptiveSelectorNode::set_window(unsigned int window)
+{
+	if (window == 0)
+	{
+		throw std::invalid_argument("the window of an adaptive selector must be positive");
+	}
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	window_ = window;
+}
+unsigned int BT::AdaptiveSelectorNode::get_window()
+{
+	return window_;
+}
+std::vector<BT::AdaptiveChildStatistics> BT::AdaptiveSelectorNode::GetChildrenStatistics()
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	std::vector<AdaptiveChildStatistics> result(statistics_.size());
+	for (unsigned int i = 0; i < statistics_.size(); i++)
+	{
+		result[i].node = children_nodes_[i];
+		result[i].is_reorderable = statistics_[i].is_reorderable;
+		result[i].ticks = statistics_[i].ticks;
+		result[i].success_rate = statistics_[i].success_rate;
+		result[i].mean_cost_us = statistics_[i].mean_cost_ns / 1000.0;
+	}
+	return result;
+}
+double BT::AdaptiveSelectorNode::GetExpectedTickCostUs()
+{
+	// A child is ticked if all the ones before it have failed
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	double cost_ns = 0.0;
+	double reach_probability = 1.0;
+	for (unsigned int i = 0; i < statistics_.size(); i++)
+	{
+		cost_ns += reach_probability * statistics_[i].mean_cost_ns;
+		reach_probability *= 1.0 - statistics_[i].success_rate;
+	}
+	return cost_ns / 1000.0;
+}
+unsigned long long BT::AdaptiveSelectorNode::GetReordersNumber()
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	return reorders_;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include"BTs.h"
+#include <mutex>
+#include <vector>
+
+
+namespace BT
+{
+	// What an adaptive selector has measured on one of its children
+	struct AdaptiveChildStatistics
+	{
+		TreeNode* node;
+		bool is_reorderable;
+		unsigned long long ticks;
+		// Probability that the child stops the selector (SUCCESS or RUNNING)
+		double success_rate;
+		double mean_cost_us;
+	};
+
+	// A selector whose children are order-independent alternatives: it measures the cost
+	// (duration of the tick) and the success rate of each child, and ticks them in the
+	// order that minimizes the expected cost of a tick, i.e. by increasing cost / success rate.
+	// The children added with AddFixedChild() keep their position: the reorderable children
+	// are only moved within the runs between them.
+	// The order is updated every reorder period ticks, never while the selector is running,
+	// and GetChildren() returns it. A child not measured yet is tried first.
+	class AdaptiveSelectorNode : public ControlNode
+	{
+	private:
+		struct ChildStatistics
+		{
+			bool is_reorderable;
+			unsigned long long ticks;
+			double success_rate;
+			double mean_cost_ns;
+		};
+
+		// Follows the children when they are reordered
+		std::vector<ChildStatistics> statistics_;
+		std::mutex statistics_mutex_;
+
+		unsigned int reorder_period_;
+		unsigned int ticks_since_reorder_;
+		unsigned int window_;
+		unsigned long long reorders_;
+
+		void InsertChild(TreeNode* child, bool is_reorderable);
+		void Record(unsigned int i, double cost_ns, bool is_success);
+		void Reorder();
+
+	public:
+		AdaptiveSelectorNode(std::string name);
+		~AdaptiveSelectorNode();
+		int DrawType();
+		BT::ReturnStatus Tick();
+
+		// Adds a reorderable child
+		void AddChild(TreeNode* child);
+		// Adds a child that stays at its position
+		void AddFixedChild(TreeNode* child);
+
+		// Ticks between two updates of the order (16 by default)
+		void set_reorder_period(unsigned int reorder_period);
+		unsigned int get_reorder_period();
+
+		// The averages follow the last window ticks of a child (64 by default)
+		void set_window(unsigned int window);
+		unsigned int get_window();
+
+		// In the current order
+		std::vector<AdaptiveChildStatistics> GetChildrenStatistics();
+
+		// Expected cost of a tick with the current order and the measured statistics
+		double GetExpectedTickCostUs();
+
+		// Number of updates that have changed the order
+		unsigned long long GetReordersNumber();
+	};
+};
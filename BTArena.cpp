@@ -0,0 +1,114 @@
+#include"BTArena.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+
+namespace
+{
+	// The interned names: the characters live in chunks that are never freed
+	class NameTable
+	{
+	private:
+		static const size_t kChunkSize = 16 * 1024;
+
+		std::mutex mutex_;
+		std::unordered_set<std::string_view> names_;
+		std::vector<std::unique_ptr<char[]>> chunks_;
+		size_t chunk_used_;
+
+	public:
+		NameTable() : chunk_used_(kChunkSize) {}
+
+		std::string_view Intern(std::string_view name)
+		{
+			std::lock_guard<std::mutex> LockGuard(mutex_);
+			std::unordered_set<std::string_view>::iterator it = names_.find(name);
+			if (it != names_.end())
+			{
+				return *it;
+			}
+
+			size_t size = name.size() + 1;
+			char* copy;
+			if (size > kChunkSize / 4)
+			{
+				// long names get their own chunk
+				chunks_.insert(chunks_.begin(), std::unique_ptr<char[]>(new char[size]));
+				copy = chunks_.front().get();
+			}
+			else
+			{
+				if (chunk_used_ + size > kChunkSize)
+				{
+					chunks_.push_back(std::unique_ptr<char[]>(new char[kChunkSize]));
+					chunk_used_ = 0;
+				}
+				copy = chunks_.back().get() + chunk_used_;
+				chunk_used_ += size;
+			}
+			std::memcpy(copy, name.data(), name.size());
+			copy[name.size()] = '\0';
+
+			std::string_view interned(copy, name.size());
+			names_.insert(interned);
+			return interned;
+		}
+	};
+
+	// Never destroyed: the names must outlive the static nodes
+	NameTable& GetNameTable()
+	{
+		static NameTable* table = new NameTable();
+		return *table;
+	}
+}
+
+
+std::string_view BT::InternName(std::string_view name)
+{
+	return GetNameTable().Intern(name);
+}
+
+
+BT::TreeArena::TreeArena(size_t block_size) : block_size_(block_size), block_used_(block_size), allocated_bytes_(0) {}
+BT::TreeArena::~TreeArena()
+{
+	for (size_t i = objects_.size(); i > 0; i--)
+	{
+		objects_[i - 1].destroy(objects_[i - 1].object);
+	}
+	for (size_t i = 0; i < blocks_.size(); i++)
+	{
+		::operator delete(blocks_[i]);
+	}
+}
+void* BT::TreeArena::Allocate(size_t size, size_t alignment)
+{
+	// The blocks come from operator new, so they are aligned for any node
+	size_t offset = (block_used_ + alignment - 1) & ~(alignment - 1);
+	if (offset + size > block_size_)
+	{
+		if (size > block_size_ / 4)
+		{
+			// large objects get their own block, the current one stays in use
+			blocks_.insert(blocks_.begin(), static_cast<char*>(::operator new(size)));
+			allocated_bytes_ += size;
+			return blocks_.front();
+		}
+		blocks_.push_back(static_cast<char*>(::operator new(block_size_)));
+		offset = 0;
+	}
+	block_used_ = offset + size;
+	allocated_bytes_ += size;
+	return blocks_.back() + offset;
+}
+size_t BT::TreeArena::GetAllocatedBytes()
+{
+	return allocated_bytes_;
+}
+size_t BT::TreeArena::GetObjectsNumber()
+{
+	return objects_.size();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace BT
+{
+	// Returns the interned copy of a name. The copies are stored once per distinct name
+	// in a process-wide table and are never freed, so the views stay valid and are
+	// null-terminated. Thread-safe; meant for node construction, not for the tick path.
+	std::string_view InternName(std::string_view name);
+
+
+	// Memory of the nodes of one tree.
+	// The nodes are placed one after the other in large blocks, and the destructor of the
+	// arena destroys them all (in reverse order of creation) and frees the blocks in one step.
+	// The nodes must not be deleted individually, and the tree must be halted
+	// (no action tick in flight) before the arena is destroyed.
+	class TreeArena
+	{
+	private:
+		struct CreatedObject
+		{
+			void (*destroy)(void* object);
+			void* object;
+		};
+
+		std::vector<char*> blocks_;
+		std::vector<CreatedObject> objects_;
+		size_t block_size_;
+		size_t block_used_;
+		size_t allocated_bytes_;
+
+		template <class T>
+		static void Destroy(void* object)
+		{
+			static_cast<T*>(object)->~T();
+		}
+
+	public:
+		TreeArena(size_t block_size = 64 * 1024);
+		~TreeArena();
+
+		TreeArena(const TreeArena&) = delete;
+		TreeArena& operator=(const TreeArena&) = delete;
+
+		// Raw memory, released with the arena
+		void* Allocate(size_t size, size_t alignment);
+
+		// Creates an object in the arena, e.g. arena.Create<BT::SequenceNode>("root")
+		template <class T, class... Args>
+		T* Create(Args&&... args)
+		{
+			void* memory = Allocate(sizeof(T), alignof(T));
+			if (objects_.size() == objects_.capacity())
+			{
+				// so that the push_back below cannot throw after the construction
+				objects_.reserve(objects_.size() * 2 + 64);
+			}
+			T* object = new (memory) T(std::forward<Args>(args)...);
+			objects_.push_back(CreatedObject{ &TreeArena::Destroy<T>, object });
+			return object;
+		}
+
+		// Number of bytes given out, and of objects created
+		size_t GetAllocatedBytes();
+		size_t GetObjectsNumber();
+	};
+};
@@ -0,0 +1,204 @@
+#include"BTBatch.h"
+#include <chrono>
+
+
+BT::BatchRunner::BatchRunner(unsigned int n_of_workers) : frame_(0), busy_workers_(0), is_stopping_(false), next_tree_(0)
+{
+	if (n_of_workers == 0)
+	{
+		n_of_workers = std::thread::hardware_concurrency();
+	}
+	if (n_of_workers == 0)
+	{
+		n_of_workers = 1;
+	}
+	worker_statistics_.reset(new WorkerStatistics[n_of_workers]);
+
+	// The worker 0 is the thread calling TickFrame()
+	for (unsigned int i = 1; i < n_of_workers; i++)
+	{
+		workers_.push_back(std::thread(&BatchRunner::WorkerLoop, this, i));
+	}
+}
+BT::BatchRunner::~BatchRunner()
+{
+	{
+		std::lock_guard<std::mutex> LockGuard(frame_mutex_);
+		is_stopping_ = true;
+	}
+	frame_condition_variable_.notify_all();
+
+	for (unsigned int i = 0; i < workers_.size(); i++)
+	{
+		workers_[i].join();
+	}
+}
+unsigned int BT::BatchRunner::AddTree(TreeNode* root)
+{
+	roots_.push_back(root);
+	statuses_.push_back(BT::IDLE);
+	return roots_.size() - 1;
+}
+unsigned int BT::BatchRunner::GetTreesNumber()
+{
+	return roots_.size();
+}
+BT::TreeNode* BT::BatchRunner::GetTree(unsigned int i)
+{
+	return roots_[i];
+}
+BT::ReturnStatus BT::BatchRunner::get_status(unsigned int i)
+{
+	return statuses_[i];
+}
+void BT::BatchRunner::AddBatchCondition(BatchCondition* condition, StatusMask* mask)
+{
+	batch_conditions_.push_back(condition);
+	batch_masks_.push_back(mask);
+}
+unsigned int BT::BatchRunner::GetWorkersNumber()
+{
+	return workers_.size() + 1;
+}
+void BT::BatchRunner::WorkerLoop(unsigned int index)
+{
+	unsigned long long last_frame = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> UniqueLock(frame_mutex_);
+			frame_condition_variable_.wait(UniqueLock, [this, last_frame]() { return is_stopping_ || frame_ != last_frame; });
+			if (is_stopping_)
+			{
+				return;
+			}
+			last_frame = frame_;
+		}
+
+		TickTrees(index);
+
+		std::lock_guard<std::mutex> LockGuard(frame_mutex_);
+		busy_workers_--;
+		if (busy_workers_ == 0)
+		{
+			done_condition_variable_.notify_all();
+		}
+	}
+}
+void BT::BatchRunner::TickTrees(unsigned int index)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	WorkerStatistics& statistics = worker_statistics_[index];
+	statistics = WorkerStatistics();
+	Clock::time_point worker_start = Clock::now();
+
+	unsigned int trees = roots_.size();
+	while (true)
+	{
+		unsigned int begin = next_tree_.fetch_add(kChunkSize, std::memory_order_relaxed);
+		if (begin >= trees)
+		{
+			break;
+		}
+		unsigned int end = (begin + kChunkSize < trees) ? begin + kChunkSize : trees;
+
+		Clock::time_point tree_start = Clock::now();
+		for (unsigned int i = begin; i < end; i++)
+		{
+			ReturnStatus status = roots_[i]->Tick();
+			statuses_[i] = status;
+
+			Clock::time_point tree_end = Clock::now();
+			double tree_us = std::chrono::duration<double, std::micro>(tree_end - tree_start).count();
+			tree_start = tree_end;
+
+			if (statistics.successes + statistics.failures + statistics.running == 0 || tree_us < statistics.min_tree_us)
+			{
+				statistics.min_tree_us = tree_us;
+			}
+			if (tree_us > statistics.max_tree_us)
+			{
+				statistics.max_tree_us = tree_us;
+			}
+			statistics.sum_tree_us += tree_us;
+
+			if (status == BT::SUCCESS)
+			{
+				statistics.successes++;
+			}
+			else if (status == BT::FAILURE)
+			{
+				statistics.failures++;
+			}
+			else
+			{
+				statistics.running++;
+			}
+		}
+	}
+	statistics.busy_us = std::chrono::duration<double, std::micro>(Clock::now() - worker_start).count();
+}
+BT::FrameStatistics BT::BatchRunner::TickFrame()
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point frame_start = Clock::now();
+
+	// The masks are complete before any tree reads them
+	for (unsigned int c = 0; c < batch_conditions_.size(); c++)
+	{
+		batch_conditions_[c]->Evaluate(*batch_masks_[c]);
+	}
+	double conditions_us = std::chrono::duration<double, std::micro>(Clock::now() - frame_start).count();
+
+	{
+		std::lock_guard<std::mutex> LockGuard(frame_mutex_);
+		next_tree_.store(0, std::memory_order_relaxed);
+		busy_workers_ = workers_.size();
+		frame_++;
+	}
+	frame_condition_variable_.notify_all();
+
+	TickTrees(0);
+
+	{
+		std::unique_lock<std::mutex> UniqueLock(frame_mutex_);
+		done_condition_variable_.wait(UniqueLock, [this]() { return busy_workers_ == 0; });
+	}
+
+	FrameStatistics frame_statistics = FrameStatistics();
+	frame_statistics.trees = roots_.size();
+	frame_statistics.conditions_us = conditions_us;
+	double sum_tree_us = 0.0;
+	for (unsigned int i = 0; i < GetWorkersNumber(); i++)
+	{
+		const WorkerStatistics& statistics = worker_statistics_[i];
+		unsigned int ticked = statistics.successes + statistics.failures + statistics.running;
+		if (ticked > 0)
+		{
+			if (frame_statistics.successes + frame_statistics.failures + frame_statistics.running == 0
+				|| statistics.min_tree_us < frame_statistics.min_tree_us)
+			{
+				frame_statistics.min_tree_us = statistics.min_tree_us;
+			}
+			if (statistics.max_tree_us > frame_statistics.max_tree_us)
+			{
+				frame_statistics.max_tree_us = statistics.max_tree_us;
+			}
+		}
+		if (statistics.busy_us > frame_statistics.max_worker_us)
+		{
+			frame_statistics.max_worker_us = statistics.busy_us;
+		}
+		frame_statistics.successes += statistics.successes;
+		frame_statistics.failures += statistics.failures;
+		frame_statistics.running += statistics.running;
+		sum_tree_us += statistics.sum_tree_us;
+	}
+	if (frame_statistics.trees > 0)
+	{
+		frame_statistics.mean_tree_us = sum_tree_us / frame_statistics.trees;
+	}
+	frame_statistics.frame_us = std::chrono::duration<double, std::micro>(Clock::now() - frame_start).count();
+	return frame_statistics;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include"BTs.h"
+#include"BTBatchCondition.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace BT
+{
+	// Timing and outcome of one frame of a BatchRunner
+	struct FrameStatistics
+	{
+		unsigned int trees;
+		unsigned int successes;
+		unsigned int failures;
+		unsigned int running;
+
+		// wall time of the whole frame
+		double frame_us;
+
+		// time of the single root ticks
+		double min_tree_us;
+		double max_tree_us;
+		double mean_tree_us;
+
+		// ticking time of the busiest worker
+		double max_worker_us;
+
+		// time spent in the batch conditions, before the trees
+		double conditions_us;
+	};
+
+	// Owns many tree instances (e.g. one per agent) and ticks all of them once per frame,
+	// split across a fixed set of worker threads. The calling thread works too.
+	// The workers claim the trees in chunks, so slow trees do not leave workers idle.
+	// The actions of the trees still run on their executor.
+	class BatchRunner
+	{
+	private:
+		struct alignas(64) WorkerStatistics
+		{
+			double busy_us;
+			double min_tree_us;
+			double max_tree_us;
+			double sum_tree_us;
+			unsigned int successes;
+			unsigned int failures;
+			unsigned int running;
+		};
+
+		static const unsigned int kChunkSize = 32;
+
+		std::vector<TreeNode*> roots_;
+		std::vector<ReturnStatus> statuses_;
+
+		std::vector<BatchCondition*> batch_conditions_;
+		std::vector<StatusMask*> batch_masks_;
+
+		std::vector<std::thread> workers_;
+		std::unique_ptr<WorkerStatistics[]> worker_statistics_;
+
+		std::mutex frame_mutex_;
+		std::condition_variable frame_condition_variable_;
+		std::condition_variable done_condition_variable_;
+		unsigned long long frame_;
+		unsigned int busy_workers_;
+		bool is_stopping_;
+		std::atomic<unsigned int> next_tree_;
+
+		void WorkerLoop(unsigned int index);
+		void TickTrees(unsigned int index);
+
+	public:
+		// n_of_workers == 0 means one worker per hardware thread (the caller included)
+		BatchRunner(unsigned int n_of_workers = 0);
+		~BatchRunner();
+
+		// The method used to add a tree; returns its index. Not to be called during TickFrame().
+		unsigned int AddTree(TreeNode* root);
+		unsigned int GetTreesNumber();
+		TreeNode* GetTree(unsigned int i);
+
+		// Status returned by the tree i in the last frame
+		ReturnStatus get_status(unsigned int i);
+
+		// The method used to evaluate a condition for all the agents at the start of every
+		// frame: the trees read their result from the mask with a MaskConditionNode.
+		// Not to be called during TickFrame().
+		void AddBatchCondition(BatchCondition* condition, StatusMask* mask);
+
+		// Ticks every tree once and returns when all are done
+		FrameStatistics TickFrame();
+
+		unsigned int GetWorkersNumber();
+	};
+};
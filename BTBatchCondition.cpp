@@ -0,0 +1,395 @@
+#include"BTBatchCondition.h"
+#include <atomic>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BT_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(BT_HAS_SSE2) && defined(__GNUC__)
+// The AVX2 kernels are compiled for their target only, and run if the CPU has it
+#define BT_HAS_AVX2 1
+#define BT_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+
+namespace
+{
+	BT::SimdLevel DetectSimdLevel()
+	{
+#if defined(BT_HAS_AVX2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return BT::SIMD_AVX2;
+		}
+#endif
+#if defined(BT_HAS_SSE2)
+		return BT::SIMD_SSE2;
+#else
+		return BT::SIMD_SCALAR;
+#endif
+	}
+
+	const BT::SimdLevel supported_level = DetectSimdLevel();
+	std::atomic<int> selected_level(supported_level);
+
+	// The kernels: a scalar test of one agent, and the bits of 4 (SSE2) or 8 (AVX2) agents
+	struct CompareKernel
+	{
+		const float* values;
+		BT::CompareOperator compare_operator;
+		float threshold;
+
+		bool Scalar(unsigned int i) const
+		{
+			switch (compare_operator)
+			{
+			case BT::COMPARE_LESS: return values[i] < threshold;
+			case BT::COMPARE_LESS_EQUAL: return values[i] <= threshold;
+			case BT::COMPARE_GREATER: return values[i] > threshold;
+			default: return values[i] >= threshold;
+			}
+		}
+#if defined(BT_HAS_SSE2)
+		unsigned int Sse2(unsigned int i) const
+		{
+			__m128 v = _mm_loadu_ps(values + i);
+			__m128 t = _mm_set1_ps(threshold);
+			switch (compare_operator)
+			{
+			case BT::COMPARE_LESS: return _mm_movemask_ps(_mm_cmplt_ps(v, t));
+			case BT::COMPARE_LESS_EQUAL: return _mm_movemask_ps(_mm_cmple_ps(v, t));
+			case BT::COMPARE_GREATER: return _mm_movemask_ps(_mm_cmpgt_ps(v, t));
+			default: return _mm_movemask_ps(_mm_cmpge_ps(v, t));
+			}
+		}
+#endif
+#if defined(BT_HAS_AVX2)
+		BT_TARGET_AVX2 unsigned int Avx2(unsigned int i) const
+		{
+			__m256 v = _mm256_loadu_ps(values + i);
+			__m256 t = _mm256_set1_ps(threshold);
+			switch (compare_operator)
+			{
+			case BT::COMPARE_LESS: return _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_LT_OQ));
+			case BT::COMPARE_LESS_EQUAL: return _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_LE_OQ));
+			case BT::COMPARE_GREATER: return _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_GT_OQ));
+			default: return _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_GE_OQ));
+			}
+		}
+#endif
+	};
+
+	struct RangeKernel
+	{
+		const float* values;
+		float lower;
+		float upper;
+
+		bool Scalar(unsigned int i) const
+		{
+			return values[i] >= lower && values[i] <= upper;
+		}
+#if defined(BT_HAS_SSE2)
+		unsigned int Sse2(unsigned int i) const
+		{
+			__m128 v = _mm_loadu_ps(values + i);
+			return _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v, _mm_set1_ps(lower)), _mm_cmple_ps(v, _mm_set1_ps(upper))));
+		}
+#endif
+#if defined(BT_HAS_AVX2)
+		BT_TARGET_AVX2 unsigned int Avx2(unsigned int i) const
+		{
+			__m256 v = _mm256_loadu_ps(values + i);
+			return _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(v, _mm256_set1_ps(lower), _CMP_GE_OQ),
+				_mm256_cmp_ps(v, _mm256_set1_ps(upper), _CMP_LE_OQ)));
+		}
+#endif
+	};
+
+	struct DistanceKernel
+	{
+		const float* x;
+		const float* y;
+		const float* target_x;
+		const float* target_y;
+		float squared_radius;
+
+		bool Scalar(unsigned int i) const
+		{
+			float dx = x[i] - target_x[i];
+			float dy = y[i] - target_y[i];
+			return dx * dx + dy * dy <= squared_radius;
+		}
+#if defined(BT_HAS_SSE2)
+		unsigned int Sse2(unsigned int i) const
+		{
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(target_x + i));
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(target_y + i));
+			__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			return _mm_movemask_ps(_mm_cmple_ps(d2, _mm_set1_ps(squared_radius)));
+		}
+#endif
+#if defined(BT_HAS_AVX2)
+		BT_TARGET_AVX2 unsigned int Avx2(unsigned int i) const
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(target_x + i));
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(target_y + i));
+			__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			return _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_set1_ps(squared_radius), _CMP_LE_OQ));
+		}
+#endif
+	};
+
+	// The drivers fill the mask 64 agents (one word) at a time; the last partial word is scalar
+	template <class Kernel>
+	void FillTail(const Kernel& kernel, unsigned int begin, unsigned int size, unsigned long long* words)
+	{
+		if (begin < size)
+		{
+			unsigned long long bits = 0;
+			for (unsigned int i = begin; i < size; i++)
+			{
+				bits |= (unsigned long long)kernel.Scalar(i) << (i & 63);
+			}
+			words[begin >> 6] = bits;
+		}
+	}
+
+	template <class Kernel>
+	void FillScalar(const Kernel& kernel, unsigned int size, unsigned long long* words)
+	{
+		unsigned int full = size & ~63u;
+		for (unsigned int base = 0; base < full; base += 64)
+		{
+			unsigned long long bits = 0;
+			for (unsigned int j = 0; j < 64; j++)
+			{
+				bits |= (unsigned long long)kernel.Scalar(base + j) << j;
+			}
+			words[base >> 6] = bits;
+		}
+		FillTail(kernel, full, size, words);
+	}
+
+#if defined(BT_HAS_SSE2)
+	template <class Kernel>
+	void FillSse2(const Kernel& kernel, unsigned int size, unsigned long long* words)
+	{
+		unsigned int full = size & ~63u;
+		for (unsigned int base = 0; base < full; base += 64)
+		{
+			unsigned long long bits = 0;
+			for (unsigned int j = 0; j < 64; j += 4)
+			{
+				bits |= (unsigned long long)kernel.Sse2(base + j) << j;
+			}
+			words[base >> 6] = bits;
+		}
+		FillTail(kernel, full, size, words);
+	}
+#endif
+
+#if defined(BT_HAS_AVX2)
+	template <class Kernel>
+	BT_TARGET_AVX2 void FillAvx2(const Kernel& kernel, unsigned int size, unsigned long long* words)
+	{
+		unsigned int full = size & ~63u;
+		for (unsigned int base = 0; base < full; base += 64)
+		{
+			unsigned long long bits = 0;
+			for (unsigned int j = 0; j < 64; j += 8)
+			{
+				bits |= (unsigned long long)kernel.Avx2(base + j) << j;
+			}
+			words[base >> 6] = bits;
+		}
+		FillTail(kernel, full, size, words);
+	}
+#endif
+
+	template <class Kernel>
+	void Fill(const Kernel& kernel, unsigned int size, BT::StatusMask& mask)
+	{
+		mask.Resize(size);
+		switch (BT::GetSimdLevel())
+		{
+#if defined(BT_HAS_AVX2)
+		case BT::SIMD_AVX2:
+			FillAvx2(kernel, size, mask.data());
+			break;
+#endif
+#if defined(BT_HAS_SSE2)
+		case BT::SIMD_SSE2:
+			FillSse2(kernel, size, mask.data());
+			break;
+#endif
+		default:
+			FillScalar(kernel, size, mask.data());
+			break;
+		}
+	}
+}
+
+
+BT::SimdLevel BT::GetSupportedSimdLevel()
+{
+	return supported_level;
+}
+BT::SimdLevel BT::GetSimdLevel()
+{
+	return (SimdLevel)selected_level.load(std::memory_order_relaxed);
+}
+void BT::SetSimdLevel(SimdLevel level)
+{
+	selected_level.store(level < supported_level ? level : supported_level);
+}
+
+
+BT::StatusMask::StatusMask(unsigned int size)
+{
+	Resize(size);
+}
+void BT::StatusMask::Resize(unsigned int size)
+{
+	size_ = size;
+	words_.assign((size + 63) / 64, 0);
+}
+unsigned int BT::StatusMask::Count() const
+{
+	unsigned int count = 0;
+	for (unsigned int w = 0; w < words_.size(); w++)
+	{
+#if defined(__GNUC__)
+		count += __builtin_popcountll(words_[w]);
+#else
+		for (unsigned long long bits = words_[w]; bits != 0; bits &= bits - 1)
+		{
+			count++;
+		}
+#endif
+	}
+	return count;
+}
+void BT::StatusMask::And(const StatusMask& other)
+{
+	if (other.size_ != size_)
+	{
+		throw std::invalid_argument("the masks are not on the same agents");
+	}
+	for (unsigned int w = 0; w < words_.size(); w++)
+	{
+		words_[w] &= other.words_[w];
+	}
+}
+void BT::StatusMask::Or(const StatusMask& other)
+{
+	if (other.size_ != size_)
+	{
+		throw std::invalid_argument("the masks are not on the same agents");
+	}
+	for (unsigned int w = 0; w < words_.size(); w++)
+	{
+		words_[w] |= other.words_[w];
+	}
+}
+void BT::StatusMask::Invert()
+{
+	for (unsigned int w = 0; w < words_.size(); w++)
+	{
+		words_[w] = ~words_[w];
+	}
+	// keeps the bits past the last agent clear
+	if (size_ % 64 != 0)
+	{
+		words_.back() &= (1ull << (size_ % 64)) - 1;
+	}
+}
+
+
+
+BT::CompareCondition::CompareCondition(const float* values, unsigned int agents_number, CompareOperator compare_operator, float threshold)
+	: values_(values), agents_number_(agents_number), operator_(compare_operator), threshold_(threshold) {}
+void BT::CompareCondition::Evaluate(StatusMask& mask)
+{
+	CompareKernel kernel = { values_, operator_, threshold_ };
+	Fill(kernel, agents_number_, mask);
+}
+unsigned int BT::CompareCondition::GetAgentsNumber()
+{
+	return agents_number_;
+}
+void BT::CompareCondition::set_data(const float* values, unsigned int agents_number)
+{
+	values_ = values;
+	agents_number_ = agents_number;
+}
+void BT::CompareCondition::set_threshold(float threshold)
+{
+	threshold_ = threshold;
+}
+float BT::CompareCondition::get_threshold()
+{
+	return threshold_;
+}
+
+
+
+BT::RangeCondition::RangeCondition(const float* values, unsigned int agents_number, float lower, float upper)
+	: values_(values), agents_number_(agents_number), lower_(lower), upper_(upper) {}
+void BT::RangeCondition::Evaluate(StatusMask& mask)
+{
+	RangeKernel kernel = { values_, lower_, upper_ };
+	Fill(kernel, agents_number_, mask);
+}
+unsigned int BT::RangeCondition::GetAgentsNumber()
+{
+	return agents_number_;
+}
+void BT::RangeCondition::set_data(const float* values, unsigned int agents_number)
+{
+	values_ = values;
+	agents_number_ = agents_number;
+}
+void BT::RangeCondition::set_range(float lower, float upper)
+{
+	lower_ = lower;
+	upper_ = upper;
+}
+
+
+
+BT::DistanceCondition::DistanceCondition(const float* x, const float* y, const float* target_x, const float* target_y, unsigned int agents_number, float radius)
+	: x_(x), y_(y), target_x_(target_x), target_y_(target_y), agents_number_(agents_number), radius_(radius) {}
+void BT::DistanceCondition::Evaluate(StatusMask& mask)
+{
+	DistanceKernel kernel = { x_, y_, target_x_, target_y_, radius_ * radius_ };
+	Fill(kernel, agents_number_, mask);
+}
+unsigned int BT::DistanceCondition::GetAgentsNumber()
+{
+	return agents_number_;
+}
+void BT::DistanceCondition::set_data(const float* x, const float* y, const float* target_x, const float* target_y, unsigned int agents_number)
+{
+	x_ = x;
+	y_ = y;
+	target_x_ = target_x;
+	target_y_ = target_y;
+	agents_number_ = agents_number;
+}
+void BT::DistanceCondition::set_radius(float radius)
+{
+	radius_ = radius;
+}
+
+
+
+BT::MaskConditionNode::MaskConditionNode(std::string name, const StatusMask* mask, unsigned int agent)
+	: ConditionNode::ConditionNode(name), mask_(mask), agent_(agent) {}
+BT::MaskConditionNode::~MaskConditionNode() {}
+BT::ReturnStatus BT::MaskConditionNode::Tick()
+{
+	return mask_->get_status(agent_);
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include"BTs.h"
+#include <vector>
+
+
+namespace BT
+{
+	// Instruction sets used by the batch condition kernels.
+	// The best one supported by the CPU is chosen at run time. The comparisons give the same
+	// results on every level; a distance equal to the radius up to rounding may not.
+	enum SimdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+	SimdLevel GetSupportedSimdLevel();
+	SimdLevel GetSimdLevel();
+
+	// Forces a level (e.g. to compare them); it is lowered to the supported one
+	void SetSimdLevel(SimdLevel level);
+
+
+	// One bit per agent: set if the condition holds (SUCCESS), clear if not (FAILURE)
+	class StatusMask
+	{
+	private:
+		std::vector<unsigned long long> words_;
+		unsigned int size_;
+
+	public:
+		StatusMask(unsigned int size = 0);
+
+		// Changes the number of agents and clears all the bits
+		void Resize(unsigned int size);
+		unsigned int size() const { return size_; }
+
+		bool test(unsigned int i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+		ReturnStatus get_status(unsigned int i) const { return test(i) ? BT::SUCCESS : BT::FAILURE; }
+
+		// Number of agents for which the condition holds
+		unsigned int Count() const;
+
+		// Combines with the mask of another condition on the same agents
+		void And(const StatusMask& other);
+		void Or(const StatusMask& other);
+		void Invert();
+
+		// 64 agents per word, agent i in bit i % 64 of word i / 64; the bits past size() are 0
+		unsigned long long* data() { return words_.data(); }
+		const unsigned long long* data() const { return words_.data(); }
+	};
+
+
+	// A condition evaluated for all the agents at once, over struct-of-arrays data:
+	// the arrays are owned by the caller and read in place.
+	class BatchCondition
+	{
+	public:
+		virtual ~BatchCondition() {}
+
+		// Resizes the mask to the number of agents and writes the results
+		virtual void Evaluate(StatusMask& mask) = 0;
+		virtual unsigned int GetAgentsNumber() = 0;
+	};
+
+	enum CompareOperator { COMPARE_LESS, COMPARE_LESS_EQUAL, COMPARE_GREATER, COMPARE_GREATER_EQUAL };
+
+	// values[i] <operator> threshold, e.g. the speed of every agent against a limit
+	class CompareCondition : public BatchCondition
+	{
+	private:
+		const float* values_;
+		unsigned int agents_number_;
+		CompareOperator operator_;
+		float threshold_;
+
+	public:
+		CompareCondition(const float* values, unsigned int agents_number, CompareOperator compare_operator, float threshold);
+		void Evaluate(StatusMask& mask);
+		unsigned int GetAgentsNumber();
+
+		void set_data(const float* values, unsigned int agents_number);
+		void set_threshold(float threshold);
+		float get_threshold();
+	};
+
+	// lower <= values[i] <= upper
+	class RangeCondition : public BatchCondition
+	{
+	private:
+		const float* values_;
+		unsigned int agents_number_;
+		float lower_;
+		float upper_;
+
+	public:
+		RangeCondition(const float* values, unsigned int agents_number, float lower, float upper);
+		void Evaluate(StatusMask& mask);
+		unsigned int GetAgentsNumber();
+
+		void set_data(const float* values, unsigned int agents_number);
+		void set_range(float lower, float upper);
+	};
+
+	// The distance between (x[i], y[i]) and (target_x[i], target_y[i]) is at most radius
+	class DistanceCondition : public BatchCondition
+	{
+	private:
+		const float* x_;
+		const float* y_;
+		const float* target_x_;
+		const float* target_y_;
+		unsigned int agents_number_;
+		float radius_;
+
+	public:
+		DistanceCondition(const float* x, const float* y, const float* target_x, const float* target_y, unsigned int agents_number, float radius);
+		void Evaluate(StatusMask& mask);
+		unsigned int GetAgentsNumber();
+
+		void set_data(const float* x, const float* y, const float* target_x, const float* target_y, unsigned int agents_number);
+		void set_radius(float radius);
+	};
+
+
+	// Leaf of the tree of one agent that reads its bit of a mask computed for the whole
+	// batch (e.g. by BatchRunner::AddBatchCondition()) instead of evaluating the condition
+	class MaskConditionNode : public ConditionNode
+	{
+	private:
+		const StatusMask* mask_;
+		unsigned int agent_;
+
+	public:
+		MaskConditionNode(std::string name, const StatusMask* mask, unsigned int agent);
+		~MaskConditionNode();
+		BT::ReturnStatus Tick();
+	};
+};
@@ -0,0 +1,192 @@
+#include"BTBlackboard.h"
+
+
+BT::Blackboard::Snapshot::~Snapshot()
+{
+	if (blackboard_ != nullptr)
+	{
+		blackboard_->ReleaseFrame(frame_);
+	}
+}
+unsigned long long BT::Blackboard::Snapshot::get_generation() const
+{
+	return blackboard_->frames_[frame_].generation;
+}
+
+
+BT::Blackboard::Blackboard(unsigned int max_entries, unsigned int capacity_bytes)
+	: entries_number_(0), current_frame_(0), generation_(0)
+{
+	max_entries_ = max_entries;
+	capacity_ = capacity_bytes;
+	used_bytes_ = 0;
+	entries_.reset(new Entry[max_entries_]);
+	staging_.reset(new unsigned char[capacity_]());
+
+	for (unsigned int f = 0; f < kFramesNumber; f++)
+	{
+		frames_[f].data.reset(new unsigned char[capacity_]());
+		frames_[f].copied_sequences.reset(new unsigned int[max_entries_]());
+		frames_[f].readers = 0;
+		frames_[f].generation = 0;
+	}
+}
+BT::Blackboard::~Blackboard() {}
+unsigned int BT::Blackboard::FindEntry(const std::string& name, const std::type_info& type)
+{
+	unsigned int entries_number = entries_number_.load(std::memory_order_acquire);
+	for (unsigned int i = 0; i < entries_number; i++)
+	{
+		if (entries_[i].name == name)
+		{
+			if (*entries_[i].type != type)
+			{
+				throw std::invalid_argument("blackboard entry '" + name + "' is declared with another type.");
+			}
+			return i;
+		}
+	}
+	return ~0u;
+}
+unsigned int BT::Blackboard::DeclareEntry(const std::string& name, const std::type_info& type, unsigned int size, unsigned int alignment, const void* initial_value)
+{
+	std::lock_guard<std::mutex> LockGuard(publish_mutex_);
+
+	unsigned int index = FindEntry(name, type);
+	if (index != ~0u)
+	{
+		return index;
+	}
+
+	// The storage is aligned to max_align_t, so aligning the offset aligns the value
+	unsigned int offset = (used_bytes_ + alignment - 1) / alignment * alignment;
+	index = entries_number_.load();
+	if (index == max_entries_ || offset + size > capacity_)
+	{
+		throw std::length_error("blackboard is full, cannot declare '" + name + "'.");
+	}
+	used_bytes_ = offset + size;
+
+	// Nobody can read the new entry before the key is returned: all the copies are written directly
+	Entry& entry = entries_[index];
+	entry.name = name;
+	entry.type = &type;
+	entry.offset = offset;
+	entry.size = size;
+	entry.sequence = 0;
+	std::memcpy(staging_.get() + offset, initial_value, size);
+	for (unsigned int f = 0; f < kFramesNumber; f++)
+	{
+		std::memcpy(frames_[f].data.get() + offset, initial_value, size);
+		frames_[f].copied_sequences[index] = 0;
+	}
+
+	entries_number_.store(index + 1, std::memory_order_release);
+	return index;
+}
+void BT::Blackboard::Write(unsigned int index, unsigned int offset, const void* value, unsigned int size)
+{
+	Entry& entry = entries_[index];
+
+	// Seqlock write: makes the sequence odd (waiting only for another writer of this entry)
+	unsigned int sequence = entry.sequence.load(std::memory_order_relaxed);
+	while (true)
+	{
+		if ((sequence & 1) == 0 && entry.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			break;
+		}
+		sequence = entry.sequence.load(std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(staging_.get() + offset, value, size);
+
+	entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+bool BT::Blackboard::Publish()
+{
+	std::lock_guard<std::mutex> LockGuard(publish_mutex_);
+
+	// Picks a frame that is neither current nor pinned by a snapshot
+	unsigned int current = current_frame_.load();
+	unsigned int target = kFramesNumber;
+	for (unsigned int f = 0; f < kFramesNumber; f++)
+	{
+		if (f != current && frames_[f].readers.load() == 0)
+		{
+			target = f;
+			break;
+		}
+	}
+	if (target == kFramesNumber)
+	{
+		return false;
+	}
+
+	Frame& frame = frames_[target];
+	unsigned int entries_number = entries_number_.load(std::memory_order_acquire);
+	for (unsigned int i = 0; i < entries_number; i++)
+	{
+		Entry& entry = entries_[i];
+		unsigned int sequence = entry.sequence.load(std::memory_order_acquire);
+		if (sequence == frame.copied_sequences[i])
+		{
+			// up to date
+			continue;
+		}
+
+		if ((sequence & 1) == 0)
+		{
+			std::memcpy(frame.data.get() + entry.offset, staging_.get() + entry.offset, entry.size);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (entry.sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				frame.copied_sequences[i] = sequence;
+				continue;
+			}
+		}
+
+		// Being written, or a writer came in during the copy: the value will be copied by
+		// the next Publish(), the frame takes the one of the current frame meanwhile (its
+		// own may be older, and the frame is going to be the current one)
+		if (frame.copied_sequences[i] != frames_[current].copied_sequences[i])
+		{
+			std::memcpy(frame.data.get() + entry.offset, frames_[current].data.get() + entry.offset, entry.size);
+			frame.copied_sequences[i] = frames_[current].copied_sequences[i];
+		}
+	}
+
+	frame.generation = ++generation_;
+	current_frame_.store(target);
+	return true;
+}
+BT::Blackboard::Snapshot BT::Blackboard::GetSnapshot()
+{
+	while (true)
+	{
+		unsigned int frame = current_frame_.load();
+		frames_[frame].readers.fetch_add(1);
+
+		// The frame is pinned only if it is still the current one
+		if (current_frame_.load() == frame)
+		{
+			return Snapshot(this, frame);
+		}
+		frames_[frame].readers.fetch_sub(1);
+	}
+}
+unsigned int BT::Blackboard::get_published_version(unsigned int index)
+{
+	Snapshot snapshot = GetSnapshot();
+	return frames_[snapshot.frame_].copied_sequences[index] / 2;
+}
+void BT::Blackboard::ReleaseFrame(unsigned int frame)
+{
+	frames_[frame].readers.fetch_sub(1);
+}
+unsigned long long BT::Blackboard::get_generation()
+{
+	return generation_.load();
+}
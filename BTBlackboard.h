@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+
+
+namespace BT
+{
+	class Blackboard;
+
+	// Typed handle of a blackboard entry, returned by Blackboard::Declare()
+	template <typename T>
+	class BlackboardKey
+	{
+	private:
+		unsigned int index_;
+		unsigned int offset_;
+		friend class Blackboard;
+
+	public:
+		BlackboardKey() : index_(~0u), offset_(0) {}
+		bool is_valid() const { return index_ != ~0u; }
+		unsigned int get_index() const { return index_; }
+	};
+
+
+	// Typed, lock-free blackboard shared by the nodes of a tree and the rest of the program.
+	//
+	// Writers (any thread) write to a staging area with a per-entry seqlock: they never
+	// wait for the readers and only contend with the writers of the same entry.
+	// Publish(), called by the tick thread once per tick, copies the modified entries
+	// into one of three frames and makes it the current one. A Snapshot pins the current
+	// frame: its values are read in place (zero-copy) and stay consistent with each other
+	// until the snapshot is released, whatever the writers do in the meantime.
+	// Publish() never blocks: an entry being written is copied at the next Publish(),
+	// and if no frame is free (all pinned) the publication is postponed.
+	//
+	// The values must be trivially copyable; the entries and the storage are bounded at
+	// construction so that the frames never move.
+	class Blackboard
+	{
+	public:
+		// RAII handle on a published frame
+		class Snapshot
+		{
+		private:
+			Blackboard* blackboard_;
+			unsigned int frame_;
+			friend class Blackboard;
+			Snapshot(Blackboard* blackboard, unsigned int frame) : blackboard_(blackboard), frame_(frame) {}
+
+		public:
+			Snapshot(Snapshot&& other) : blackboard_(other.blackboard_), frame_(other.frame_) { other.blackboard_ = nullptr; }
+			Snapshot(const Snapshot&) = delete;
+			Snapshot& operator=(const Snapshot&) = delete;
+			~Snapshot();
+
+			template <typename T>
+			const T& Get(const BlackboardKey<T>& key) const
+			{
+				return *reinterpret_cast<const T*>(blackboard_->frames_[frame_].data.get() + key.offset_);
+			}
+
+			// Number of Publish() calls that produced this frame
+			unsigned long long get_generation() const;
+
+			// Number of writes of the entry contained in this frame
+			template <typename T>
+			unsigned int get_version(const BlackboardKey<T>& key) const
+			{
+				return blackboard_->frames_[frame_].copied_sequences[key.index_] / 2;
+			}
+		};
+
+	private:
+		struct Entry
+		{
+			std::string name;
+			const std::type_info* type;
+			unsigned int offset;
+			unsigned int size;
+
+			// Seqlock of the staging copy: odd while a writer is copying
+			std::atomic<unsigned int> sequence;
+		};
+
+		struct Frame
+		{
+			std::unique_ptr<unsigned char[]> data;
+
+			// Staging sequence of each entry when it was copied in this frame
+			std::unique_ptr<unsigned int[]> copied_sequences;
+			std::atomic<unsigned int> readers;
+			unsigned long long generation;
+		};
+
+		static const unsigned int kFramesNumber = 3;
+
+		unsigned int max_entries_;
+		unsigned int capacity_;
+		std::unique_ptr<Entry[]> entries_;
+		std::atomic<unsigned int> entries_number_;
+		unsigned int used_bytes_;
+		std::unique_ptr<unsigned char[]> staging_;
+
+		Frame frames_[kFramesNumber];
+		std::atomic<unsigned int> current_frame_;
+		std::atomic<unsigned long long> generation_;
+
+		// Serializes Declare() and Publish(); never taken by readers and writers
+		std::mutex publish_mutex_;
+
+		unsigned int DeclareEntry(const std::string& name, const std::type_info& type, unsigned int size, unsigned int alignment, const void* initial_value);
+		unsigned int FindEntry(const std::string& name, const std::type_info& type);
+		void Write(unsigned int index, unsigned int offset, const void* value, unsigned int size);
+		void ReleaseFrame(unsigned int frame);
+
+	public:
+		// max_entries and capacity_bytes bound the number and the total size of the entries
+		Blackboard(unsigned int max_entries = 256, unsigned int capacity_bytes = 64 * 1024);
+		~Blackboard();
+
+		// Interns a key. Declaring an existing name returns the same key;
+		// throws std::invalid_argument if the type differs, std::length_error if full.
+		template <typename T>
+		BlackboardKey<T> Declare(const std::string& name, const T& initial_value = T())
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "blackboard values must be trivially copyable");
+			BlackboardKey<T> key;
+			key.index_ = DeclareEntry(name, typeid(T), sizeof(T), alignof(T), &initial_value);
+			key.offset_ = entries_[key.index_].offset;
+			return key;
+		}
+
+		// Returns the key of a declared entry, or an invalid key
+		template <typename T>
+		BlackboardKey<T> GetKey(const std::string& name)
+		{
+			BlackboardKey<T> key;
+			key.index_ = FindEntry(name, typeid(T));
+			if (key.is_valid())
+			{
+				key.offset_ = entries_[key.index_].offset;
+			}
+			return key;
+		}
+
+		// Writes a value; it becomes visible to the readers at the next Publish()
+		template <typename T>
+		void Set(const BlackboardKey<T>& key, const T& value)
+		{
+			Write(key.index_, key.offset_, &value, sizeof(T));
+		}
+
+		// Number of writes of an entry so far (including the ones not yet published)
+		template <typename T>
+		unsigned int get_version(const BlackboardKey<T>& key)
+		{
+			return entries_[key.index_].sequence.load(std::memory_order_acquire) / 2;
+		}
+
+		// Number of writes of an entry contained in the current frame, i.e. visible to the readers
+		template <typename T>
+		unsigned int get_published_version(const BlackboardKey<T>& key)
+		{
+			return get_published_version(key.get_index());
+		}
+		unsigned int get_published_version(unsigned int index);
+
+		// Pins the current frame
+		Snapshot GetSnapshot();
+
+		// Publishes the values written since the last call; to be called at the tick boundary.
+		// Returns false if no frame was free.
+		bool Publish();
+
+		// Number of Publish() calls that produced a new frame
+		unsigned long long get_generation();
+	};
+};
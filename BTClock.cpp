@@ -0,0 +1,262 @@
+#include"BTClock.h"
+#include <algorithm>
+
+
+namespace
+{
+	std::atomic<BT::Clock*> default_clock(nullptr);
+
+	// Depth of the ActivityScopes of the thread
+	thread_local unsigned int activity_depth = 0;
+}
+
+
+void BT::Clock::SleepUntil(time_point deadline)
+{
+	std::mutex mutex;
+	std::condition_variable condition_variable;
+	std::unique_lock<std::mutex> UniqueLock(mutex);
+	WaitUntil(UniqueLock, condition_variable, deadline, []() { return false; });
+}
+void BT::Clock::SleepFor(std::chrono::nanoseconds duration)
+{
+	SleepUntil(now() + duration);
+}
+bool BT::Clock::WaitFor(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+	std::chrono::nanoseconds duration, const std::function<bool()>& predicate)
+{
+	return WaitUntil(lock, condition_variable, now() + duration, predicate);
+}
+
+
+
+BT::Clock::ActivityScope::ActivityScope()
+{
+	activity_depth++;
+}
+BT::Clock::ActivityScope::~ActivityScope()
+{
+	activity_depth--;
+}
+bool BT::Clock::is_thread_active()
+{
+	return activity_depth > 0;
+}
+
+
+
+BT::Clock::time_point BT::SystemClock::now()
+{
+	return std::chrono::steady_clock::now();
+}
+bool BT::SystemClock::WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+	time_point deadline, const std::function<bool()>& predicate)
+{
+	return condition_variable.wait_until(lock, deadline, predicate);
+}
+
+
+
+BT::SimulatedClock::SimulatedClock(bool is_advancing) : now_(), is_advancing_(is_advancing), activities_(0), waiting_activities_(0), jumps_(0) {}
+BT::SimulatedClock::~SimulatedClock() {}
+BT::Clock::time_point BT::SimulatedClock::now()
+{
+	std::lock_guard<std::mutex> LockGuard(mutex_);
+	return now_;
+}
+bool BT::SimulatedClock::WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+	time_point deadline, const std::function<bool()>& predicate)
+{
+	if (predicate())
+	{
+		return true;
+	}
+
+	Timer timer;
+	timer.deadline = deadline;
+	timer.mutex = lock.mutex();
+	timer.condition_variable = &condition_variable;
+	timer.is_expired = false;
+	timer.is_notifying = false;
+	timer.is_active = is_thread_active();
+
+	// The lock of the caller is released while the clock jumps: the jump locks the mutex
+	// of every expired timer, which may be this one (the wait slots are shared)
+	lock.unlock();
+	{
+		std::unique_lock<std::mutex> ClockLock(mutex_);
+		if (now_ >= deadline)
+		{
+			timer.is_expired = true;
+		}
+		else
+		{
+			timers_.push_back(&timer);
+			if (timer.is_active)
+			{
+				waiting_activities_++;
+			}
+			AdvanceIfIdle(ClockLock);
+		}
+	}
+	lock.lock();
+
+	// The timer is expired under the mutex of the clock, then its mutex is locked before
+	// the notification: the check below cannot miss it
+	while (!predicate() && !timer.is_expired.load())
+	{
+		condition_variable.wait(lock);
+	}
+
+	// The timer must not be in use by a jump when it goes out of scope
+	lock.unlock();
+	{
+		std::unique_lock<std::mutex> ClockLock(mutex_);
+		RemoveTimer(&timer);
+		notified_condition_variable_.wait(ClockLock, [&timer]() { return !timer.is_notifying; });
+	}
+	lock.lock();
+	return predicate();
+}
+void BT::SimulatedClock::BeginActivity()
+{
+	std::lock_guard<std::mutex> LockGuard(mutex_);
+	activities_++;
+}
+void BT::SimulatedClock::EndActivity()
+{
+	std::unique_lock<std::mutex> ClockLock(mutex_);
+	activities_--;
+	// the last running activity may have been the one holding the time
+	AdvanceIfIdle(ClockLock);
+}
+void BT::SimulatedClock::AdvanceIfIdle(std::unique_lock<std::mutex>& clock_lock)
+{
+	if (is_advancing_ && !timers_.empty() && waiting_activities_ >= activities_)
+	{
+		jumps_++;
+		AdvanceTo(clock_lock, GetNextDeadline());
+	}
+}
+void BT::SimulatedClock::RemoveTimer(Timer* timer)
+{
+	std::vector<Timer*>::iterator it = std::find(timers_.begin(), timers_.end(), timer);
+	if (it != timers_.end())
+	{
+		timers_.erase(it);
+		if (timer->is_active)
+		{
+			waiting_activities_--;
+		}
+	}
+}
+BT::Clock::time_point BT::SimulatedClock::GetNextDeadline()
+{
+	time_point next = timers_.front()->deadline;
+	for (unsigned int i = 1; i < timers_.size(); i++)
+	{
+		next = std::min(next, timers_[i]->deadline);
+	}
+	return next;
+}
+void BT::SimulatedClock::AdvanceTo(std::unique_lock<std::mutex>& clock_lock, time_point time)
+{
+	if (time > now_)
+	{
+		now_ = time;
+	}
+
+	std::vector<Timer*> expired_timers;
+	for (unsigned int i = 0; i < timers_.size();)
+	{
+		if (timers_[i]->deadline <= now_)
+		{
+			if (timers_[i]->is_active)
+			{
+				waiting_activities_--;
+			}
+			timers_[i]->is_expired = true;
+			timers_[i]->is_notifying = true;
+			expired_timers.push_back(timers_[i]);
+			timers_[i] = timers_.back();
+			timers_.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+	if (expired_timers.empty())
+	{
+		return;
+	}
+
+	// The mutexes of the timers are locked without the one of the clock (the waiters
+	// take them in the other order)
+	clock_lock.unlock();
+	for (unsigned int i = 0; i < expired_timers.size(); i++)
+	{
+		{
+			std::lock_guard<std::mutex> LockGuard(*expired_timers[i]->mutex);
+		}
+		expired_timers[i]->condition_variable->notify_all();
+	}
+	clock_lock.lock();
+
+	for (unsigned int i = 0; i < expired_timers.size(); i++)
+	{
+		expired_timers[i]->is_notifying = false;
+	}
+	notified_condition_variable_.notify_all();
+}
+void BT::SimulatedClock::Advance(std::chrono::nanoseconds duration)
+{
+	std::unique_lock<std::mutex> ClockLock(mutex_);
+	AdvanceTo(ClockLock, now_ + duration);
+}
+bool BT::SimulatedClock::AdvanceToNextDeadline()
+{
+	std::unique_lock<std::mutex> ClockLock(mutex_);
+	if (timers_.empty())
+	{
+		return false;
+	}
+	jumps_++;
+	AdvanceTo(ClockLock, GetNextDeadline());
+	return true;
+}
+unsigned int BT::SimulatedClock::GetWaitingThreadsNumber()
+{
+	std::lock_guard<std::mutex> LockGuard(mutex_);
+	return timers_.size();
+}
+unsigned int BT::SimulatedClock::GetActivitiesNumber()
+{
+	std::lock_guard<std::mutex> LockGuard(mutex_);
+	return activities_;
+}
+unsigned long long BT::SimulatedClock::GetJumpsNumber()
+{
+	std::lock_guard<std::mutex> LockGuard(mutex_);
+	return jumps_;
+}
+
+
+
+BT::Clock* BT::GetDefaultClock()
+{
+	BT::Clock* clock = default_clock.load();
+	if (clock == nullptr)
+	{
+		// Never destroyed, as the default executor
+		static BT::SystemClock* system_clock = new BT::SystemClock();
+		BT::Clock* expected = nullptr;
+		default_clock.compare_exchange_strong(expected, system_clock);
+		clock = default_clock.load();
+	}
+	return clock;
+}
+void BT::SetDefaultClock(Clock* clock)
+{
+	default_clock.store(clock);
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+namespace BT
+{
+	// The time seen by the engine: the tick scheduler, the decorators, the coroutine sleeps
+	// and StopToken::wait_for() read it and sleep on it. The halt timeouts and the
+	// measurements (statistics, traces, logs) stay on the steady clock.
+	class Clock
+	{
+	public:
+		typedef std::chrono::steady_clock::time_point time_point;
+
+		virtual ~Clock() {}
+
+		virtual time_point now() = 0;
+
+		// Waits on the condition variable, with the lock held, until the predicate is true
+		// or the deadline is reached; returns the predicate. The notifier of the predicate
+		// must change it under the mutex of the lock.
+		virtual bool WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+			time_point deadline, const std::function<bool()>& predicate) = 0;
+
+		void SleepUntil(time_point deadline);
+		void SleepFor(std::chrono::nanoseconds duration);
+		bool WaitFor(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+			std::chrono::nanoseconds duration, const std::function<bool()>& predicate);
+
+		// The work the time must wait for: the tick loop of a scheduler, and every tick of an
+		// action from SendTick() to its end. An activity can be begun by a thread and done by
+		// another one; the thread doing it is marked with an ActivityScope while it runs.
+		virtual void BeginActivity() {}
+		virtual void EndActivity() {}
+
+		class ActivityScope
+		{
+		public:
+			ActivityScope();
+			~ActivityScope();
+		};
+
+		// True if the calling thread is inside an ActivityScope
+		static bool is_thread_active();
+	};
+
+
+	// The wall clock (std::chrono::steady_clock)
+	class SystemClock : public Clock
+	{
+	public:
+		time_point now();
+		bool WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+			time_point deadline, const std::function<bool()>& predicate);
+	};
+
+
+	// A clock that only moves when told to, or on its own by jumping straight to the next
+	// deadline: a scenario of minutes runs in the time its ticks take to compute.
+	// When it advances on its own, it jumps as soon as all the activities are waiting on it
+	// (or at once if there are none): the computation takes no time, the waits all of it,
+	// and the same scenario gives the same timeline. Blocking on anything else than the
+	// clock inside an activity (e.g. a real sleep) holds the time still meanwhile.
+	class SimulatedClock : public Clock
+	{
+	private:
+		struct Timer
+		{
+			time_point deadline;
+			std::mutex* mutex;
+			std::condition_variable* condition_variable;
+			std::atomic<bool> is_expired;
+			bool is_notifying;
+			bool is_active;
+		};
+
+		std::mutex mutex_;
+		std::condition_variable notified_condition_variable_;
+		time_point now_;
+		std::vector<Timer*> timers_;
+		bool is_advancing_;
+		unsigned int activities_;
+		unsigned int waiting_activities_;
+		unsigned long long jumps_;
+
+		// Jumps to the next deadline if all the activities wait
+		void AdvanceIfIdle(std::unique_lock<std::mutex>& clock_lock);
+		void RemoveTimer(Timer* timer);
+
+		// Moves the time and wakes up the expired timers; called with the lock of the clock,
+		// which is released while the waiters are notified
+		void AdvanceTo(std::unique_lock<std::mutex>& clock_lock, time_point time);
+		time_point GetNextDeadline();
+
+	public:
+		// The time starts at the epoch of the steady clock. Without is_advancing it only
+		// moves with Advance() and AdvanceToNextDeadline().
+		SimulatedClock(bool is_advancing = true);
+		~SimulatedClock();
+
+		time_point now();
+		bool WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& condition_variable,
+			time_point deadline, const std::function<bool()>& predicate);
+		void BeginActivity();
+		void EndActivity();
+
+		void Advance(std::chrono::nanoseconds duration);
+
+		// Jumps to the earliest deadline waited for; returns false if nobody is waiting
+		bool AdvanceToNextDeadline();
+
+		unsigned int GetWaitingThreadsNumber();
+		unsigned int GetActivitiesNumber();
+		unsigned long long GetJumpsNumber();
+	};
+
+
+	// The clock of the engine. Unless it is replaced, it is a SystemClock.
+	// Replace it before the trees start: the deadlines already computed stay on the old one.
+	Clock* GetDefaultClock();
+	void SetDefaultClock(Clock* clock);
+};
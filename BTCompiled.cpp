@@ -0,0 +1,201 @@
+#include"BTCompiled.h"
+#include"BTTrace.h"
+#include<stdexcept>
+
+
+BT::CompiledTree::CompiledTree(ControlNode* root)
+{
+	CompileNode(root);
+}
+BT::CompiledTree::~CompiledTree() {}
+void BT::CompiledTree::CompileNode(TreeNode* node)
+{
+	// The control nodes are recognized by their class, not by DrawType(): an adaptive
+	// selector, for one, is drawn as a selector but does not tick as a plain one
+	unsigned char kind;
+	if (node->get_type() == BT::ACTION_NODE)
+	{
+		kind = BT::COMPILED_ACTION;
+	}
+	else if (node->get_type() == BT::CONDITION_NODE)
+	{
+		kind = BT::COMPILED_CONDITION;
+	}
+	else if (node->get_type() == BT::STATIC_TREE_NODE)
+	{
+		// it draws as the root of its tree, but it is a leaf of this one
+		throw std::invalid_argument("'" + std::string(node->get_name()) + "' cannot be compiled: it is a static tree, already composed at compile time.");
+	}
+	else if (dynamic_cast<SequenceNode*>(node) != nullptr)
+	{
+		kind = BT::COMPILED_SEQUENCE;
+	}
+	else if (dynamic_cast<SelectorNode*>(node) != nullptr)
+	{
+		kind = BT::COMPILED_SELECTOR;
+	}
+	else
+	{
+		throw std::invalid_argument("'" + std::string(node->get_name()) + "' cannot be compiled: only Sequence, Selector, Condition and Action nodes are supported.");
+	}
+
+	unsigned int index = kinds_.size();
+	kinds_.push_back(kind);
+	subtree_end_.push_back(0);
+	status_.push_back(BT::IDLE);
+	nodes_.push_back(node);
+
+	if (kind == BT::COMPILED_SEQUENCE || kind == BT::COMPILED_SELECTOR)
+	{
+		const std::vector<TreeNode*>& children = static_cast<ControlNode*>(node)->GetChildren();
+		for (unsigned int i = 0; i < children.size(); i++)
+		{
+			CompileNode(children[i]);
+		}
+	}
+	subtree_end_[index] = kinds_.size();
+}
+BT::ReturnStatus BT::CompiledTree::Tick()
+{
+	if (kinds_.empty())
+	{
+		return BT::EXIT;
+	}
+	return TickNode(0);
+}
+BT::ReturnStatus BT::CompiledTree::TickLeaf(unsigned int i)
+{
+	TreeNode* leaf = nodes_[i];
+	ReturnStatus leaf_status;
+	BT_TRACE_TICK_BEGIN(leaf);
+
+	if (kinds_[i] == BT::COMPILED_ACTION)
+	{
+		// Same routing as ControlNode::TickChild(): the actions run on the executor
+		leaf_status = leaf->get_status();
+		if (leaf_status == BT::IDLE || leaf_status == BT::HALTED)
+		{
+			unsigned int version = leaf->get_status_version();
+			static_cast<ActionNode*>(leaf)->SendTick();
+			leaf_status = leaf->WaitForStatusChange(version);
+		}
+	}
+	else
+	{
+		leaf_status = static_cast<ConditionNode*>(leaf)->Evaluate();
+	}
+	BT_TRACE_TICK_END(leaf, leaf_status);
+	status_[i] = leaf_status;
+	return leaf_status;
+}
+void BT::CompiledTree::ResetNode(unsigned int i)
+{
+	// the child goes in idle once its result has been used by the father
+	status_[i] = BT::IDLE;
+	if (kinds_[i] == BT::COMPILED_ACTION)
+	{
+		nodes_[i]->set_status(BT::IDLE);
+	}
+}
+BT::ReturnStatus BT::CompiledTree::TickNode(unsigned int i)
+{
+	unsigned char kind = kinds_[i];
+	if (kind == BT::COMPILED_ACTION || kind == BT::COMPILED_CONDITION)
+	{
+		return TickLeaf(i);
+	}
+
+	// Sequence and selector differ only in the status that lets the tick go on
+	ReturnStatus go_on = (kind == BT::COMPILED_SEQUENCE) ? BT::SUCCESS : BT::FAILURE;
+	unsigned int end = subtree_end_[i];
+
+	for (unsigned int child = i + 1; child < end; child = subtree_end_[child])
+	{
+		ReturnStatus child_status = TickNode(child);
+		if (child_status != go_on)
+		{
+			if (child_status != BT::RUNNING)
+			{
+				ResetNode(child);
+			}
+			HaltRange(subtree_end_[child], end);
+			status_[i] = child_status;
+			return child_status;
+		}
+		ResetNode(child);
+	}
+
+	if (end == i + 1)
+	{
+		// no children, as the runtime nodes
+		return BT::EXIT;
+	}
+	status_[i] = go_on;
+	return go_on;
+}
+void BT::CompiledTree::HaltRange(unsigned int begin, unsigned int end)
+{
+	// The nodes of the range are contiguous: the subtrees that are not running are skipped whole
+	bool has_halted_actions = false;
+	unsigned int i = begin;
+	while (i < end)
+	{
+		unsigned char kind = kinds_[i];
+		if (kind == BT::COMPILED_ACTION)
+		{
+			if (nodes_[i]->get_status() == BT::RUNNING)
+			{
+				BT_TRACE_HALT(nodes_[i]);
+				static_cast<ActionNode*>(nodes_[i])->RequestHalt();
+				has_halted_actions = true;
+			}
+			i++;
+		}
+		else if (kind == BT::COMPILED_CONDITION)
+		{
+			status_[i] = BT::IDLE;
+			i++;
+		}
+		else if (status_[i] == BT::RUNNING)
+		{
+			status_[i] = BT::HALTED;
+			i++;
+		}
+		else
+		{
+			i = subtree_end_[i];
+		}
+	}
+
+	// As ControlNode::HaltChildren(): the actions stop together, then they are waited for
+	for (i = begin; has_halted_actions && i < end; i++)
+	{
+		if (kinds_[i] == BT::COMPILED_ACTION)
+		{
+			static_cast<ActionNode*>(nodes_[i])->WaitForHalt();
+		}
+	}
+}
+void BT::CompiledTree::Halt()
+{
+	if (!kinds_.empty() && status_[0] == BT::RUNNING)
+	{
+		HaltRange(0, subtree_end_[0]);
+	}
+}
+unsigned int BT::CompiledTree::GetNodesNumber()
+{
+	return kinds_.size();
+}
+BT::ReturnStatus BT::CompiledTree::get_status(unsigned int i)
+{
+	return (ReturnStatus)status_[i];
+}
+BT::CompiledNodeKind BT::CompiledTree::get_kind(unsigned int i)
+{
+	return (CompiledNodeKind)kinds_[i];
+}
+BT::TreeNode* BT::CompiledTree::get_node(unsigned int i)
+{
+	return nodes_[i];
+}
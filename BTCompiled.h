@@ -0,0 +1,51 @@
+#pragma once
+#include"BTs.h"
+#include<vector>
+
+
+namespace BT
+{
+	// Kinds of node a tree can be compiled with
+	enum CompiledNodeKind { COMPILED_SEQUENCE, COMPILED_SELECTOR, COMPILED_CONDITION, COMPILED_ACTION };
+
+	// Flat, index-based image of a tree built with ControlNode::AddChild().
+	// The nodes are stored in pre-order in separate arrays (kinds, subtree ranges, status):
+	// the first child of node i is i + 1, the next sibling of a child c is subtree_end_[c],
+	// and the subtree of i is the range [i, subtree_end_[i]).
+	// The Sequence/Selector logic is interpreted on these arrays without pointer chasing
+	// or virtual calls; only the leaves are reached through their TreeNode.
+	// The image is a copy of the structure: editing the source tree requires a new compile.
+	class CompiledTree
+	{
+	private:
+		std::vector<unsigned char> kinds_;
+		std::vector<unsigned int> subtree_end_;
+		std::vector<unsigned char> status_;
+
+		// The original nodes, used to tick the leaves
+		std::vector<TreeNode*> nodes_;
+
+		void CompileNode(TreeNode* node);
+		ReturnStatus TickNode(unsigned int i);
+		ReturnStatus TickLeaf(unsigned int i);
+		void ResetNode(unsigned int i);
+		void HaltRange(unsigned int begin, unsigned int end);
+
+	public:
+		// Compiles the tree: throws std::invalid_argument if it contains a node
+		// other than Sequence, Selector, Condition and Action
+		CompiledTree(ControlNode* root);
+		~CompiledTree();
+
+		// Ticks the root and returns its status
+		ReturnStatus Tick();
+
+		// Halts all the running nodes
+		void Halt();
+
+		unsigned int GetNodesNumber();
+		ReturnStatus get_status(unsigned int i);
+		CompiledNodeKind get_kind(unsigned int i);
+		TreeNode* get_node(unsigned int i);
+	};
+};
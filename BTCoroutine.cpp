@@ -0,0 +1,64 @@
+#include"BTCoroutine.h"
+
+#if defined(__cpp_impl_coroutine)
+
+
+BT::CoroActionNode::CoroActionNode(std::string name) : LeafNode::LeafNode(name), waiter_(nullptr)
+{
+	type_ = BT::COROUTINE_ACTION_NODE;
+}
+BT::CoroActionNode::~CoroActionNode() {}
+BT::ReturnStatus BT::CoroActionNode::Tick()
+{
+	if (!task_.is_valid())
+	{
+		// First tick: the coroutine starts suspended, it is resumed below
+		task_ = Run();
+		task_.get_handle().promise().node = this;
+		suspended_ = task_.get_handle();
+		waiter_ = nullptr;
+	}
+
+	if (waiter_ == nullptr || waiter_->IsReady())
+	{
+		// Runs until the next co_await that is not ready (or until co_return)
+		std::coroutine_handle<> handle = suspended_;
+		suspended_ = nullptr;
+		waiter_ = nullptr;
+		handle.resume();
+	}
+
+	if (!task_.is_done())
+	{
+		return BT::RUNNING;
+	}
+
+	ActionTask::promise_type& promise = task_.get_handle().promise();
+	std::exception_ptr exception = promise.exception;
+	ReturnStatus status = promise.result;
+	task_.Reset();
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+	return status;
+}
+void BT::CoroActionNode::Halt()
+{
+	// Destroying the frame runs the destructors of the coroutine locals
+	task_.Reset();
+	suspended_ = nullptr;
+	waiter_ = nullptr;
+	set_status(BT::HALTED);
+}
+int BT::CoroActionNode::DrawType()
+{
+	return BT::ACTION;
+}
+void BT::CoroActionNode::Suspend(CoroWaiter* waiter, std::coroutine_handle<> handle)
+{
+	waiter_ = waiter;
+	suspended_ = handle;
+}
+
+#endif
@@ -0,0 +1,218 @@
+#pragma once
+#include"BTs.h"
+#include"BTBlackboard.h"
+#include"BTClock.h"
+
+// Coroutine actions need C++20
+#if defined(__cpp_impl_coroutine)
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+
+namespace BT
+{
+	class CoroActionNode;
+
+	// Something a coroutine action is suspended on: the node resumes the coroutine
+	// at the first tick in which IsReady() returns true
+	class CoroWaiter
+	{
+	public:
+		virtual ~CoroWaiter() {}
+		virtual bool IsReady() = 0;
+	};
+
+
+	// The coroutine type of the actions (and of their sub-operations):
+	//     BT::ActionTask MyAction::Run() { co_await BT::Sleep(...); co_return BT::SUCCESS; }
+	// A task starts suspended; co_await on a task runs it and returns its result.
+	class ActionTask
+	{
+	public:
+		struct promise_type
+		{
+			ReturnStatus result = BT::FAILURE;
+			CoroActionNode* node = nullptr;
+			std::coroutine_handle<> continuation;
+			std::exception_ptr exception;
+
+			ActionTask get_return_object()
+			{
+				return ActionTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() noexcept { return {}; }
+
+			// Goes back to the awaiting task, if any
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					if (handle.promise().continuation)
+					{
+						return handle.promise().continuation;
+					}
+					return std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+			FinalAwaiter final_suspend() noexcept { return {}; }
+
+			void return_value(ReturnStatus status) { result = status; }
+			void unhandled_exception() { exception = std::current_exception(); }
+		};
+
+		typedef std::coroutine_handle<promise_type> Handle;
+
+	private:
+		Handle handle_;
+
+	public:
+		ActionTask() {}
+		explicit ActionTask(Handle handle) : handle_(handle) {}
+		ActionTask(ActionTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+		ActionTask& operator=(ActionTask&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				handle_ = std::exchange(other.handle_, {});
+			}
+			return *this;
+		}
+		ActionTask(const ActionTask&) = delete;
+		ActionTask& operator=(const ActionTask&) = delete;
+		~ActionTask() { Reset(); }
+
+		// Destroys the coroutine frame (and the frames of the sub-operations it awaits)
+		void Reset()
+		{
+			if (handle_)
+			{
+				handle_.destroy();
+				handle_ = {};
+			}
+		}
+		bool is_valid() const { return (bool)handle_; }
+		bool is_done() const { return handle_.done(); }
+		Handle get_handle() const { return handle_; }
+
+		// co_await on a sub-operation
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(Handle awaiting) noexcept
+		{
+			handle_.promise().node = awaiting.promise().node;
+			handle_.promise().continuation = awaiting;
+			return handle_;
+		}
+		ReturnStatus await_resume()
+		{
+			if (handle_.promise().exception)
+			{
+				std::rethrow_exception(handle_.promise().exception);
+			}
+			return handle_.promise().result;
+		}
+	};
+
+
+	// Leaf node whose Tick() resumes a coroutine on the ticking thread instead of
+	// blocking a worker: while the coroutine is suspended the node returns RUNNING,
+	// when it co_returns the node returns its status.
+	// A suspended action costs only its coroutine frame. Halt() destroys the frame.
+	class CoroActionNode : public LeafNode
+	{
+	private:
+		ActionTask task_;
+		std::coroutine_handle<> suspended_;
+		CoroWaiter* waiter_;
+
+	public:
+		// Constructor
+		CoroActionNode(std::string name);
+		~CoroActionNode();
+
+		// The coroutine started at the first tick after the node is idle
+		virtual ActionTask Run() = 0;
+
+		BT::ReturnStatus Tick();
+		void Halt();
+		int DrawType();
+
+		// Used by the awaiters to register the point to resume
+		void Suspend(CoroWaiter* waiter, std::coroutine_handle<> handle);
+	};
+
+
+	// Base of the awaiters that suspend the action until a condition holds
+	template <typename Derived>
+	class CoroAwaiter : public CoroWaiter
+	{
+	public:
+		bool await_ready() { return static_cast<Derived*>(this)->IsReady(); }
+		void await_suspend(ActionTask::Handle handle)
+		{
+			handle.promise().node->Suspend(this, handle);
+		}
+		void await_resume() {}
+	};
+
+	// co_await BT::Sleep(duration): resumes at the first tick after the duration
+	class Sleep : public CoroAwaiter<Sleep>
+	{
+	private:
+		Clock::time_point deadline_;
+
+	public:
+		template <typename Rep, typename Period>
+		Sleep(std::chrono::duration<Rep, Period> duration) : deadline_(GetDefaultClock()->now() + duration) {}
+		bool IsReady() { return GetDefaultClock()->now() >= deadline_; }
+	};
+
+	// co_await BT::NextTick(): resumes at the next tick
+	class NextTick : public CoroAwaiter<NextTick>
+	{
+	private:
+		bool is_suspended_;
+
+	public:
+		NextTick() : is_suspended_(false) {}
+		bool IsReady()
+		{
+			bool is_ready = is_suspended_;
+			is_suspended_ = true;
+			return is_ready;
+		}
+	};
+
+	// co_await BT::Until(predicate): resumes at the first tick in which predicate() is true
+	template <typename Predicate>
+	class Until : public CoroAwaiter<Until<Predicate>>
+	{
+	private:
+		Predicate predicate_;
+
+	public:
+		Until(Predicate predicate) : predicate_(std::move(predicate)) {}
+		bool IsReady() { return predicate_(); }
+	};
+
+	// co_await BT::BlackboardWrite(blackboard, key): resumes at the first tick after the entry is written
+	template <typename T>
+	class BlackboardWrite : public CoroAwaiter<BlackboardWrite<T>>
+	{
+	private:
+		Blackboard& blackboard_;
+		BlackboardKey<T> key_;
+		unsigned int version_;
+
+	public:
+		BlackboardWrite(Blackboard& blackboard, const BlackboardKey<T>& key)
+			: blackboard_(blackboard), key_(key), version_(blackboard.get_version(key)) {}
+		bool IsReady() { return blackboard_.get_version(key_) != version_; }
+	};
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include"BTDecorator.h"
+#include"BTLog.h"
+#include"BTClock.h"
+#include <stdexcept>
+
+
+BT::DecoratorNode::DecoratorNode(std::string name) : ControlNode::ControlNode(name) {}
+BT::DecoratorNode::~DecoratorNode() {}
+void BT::DecoratorNode::AddChild(TreeNode* child)
+{
+	if (!children_nodes_.empty())
+	{
+		throw std::logic_error("'" + std::string(get_name()) + "' is a decorator and already has a child.");
+	}
+	ControlNode::AddChild(child);
+}
+BT::TreeNode* BT::DecoratorNode::get_child()
+{
+	return children_nodes_.empty() ? nullptr : children_nodes_[0];
+}
+int BT::DecoratorNode::DrawType()
+{
+	return BT::DECORATOR;
+}
+BT::ReturnStatus BT::DecoratorNode::TickDecoratedChild()
+{
+	if (children_nodes_.empty())
+	{
+		throw std::logic_error("'" + std::string(get_name()) + "' is a decorator without child.");
+	}
+	N_of_children_ = 1;
+
+	ReturnStatus child_status = TickChild(0);
+	if (child_status == BT::SUCCESS || child_status == BT::FAILURE)
+	{
+		// the child goes in idle once it has returned its result
+		children_nodes_[0]->set_status(BT::IDLE);
+	}
+	return child_status;
+}
+
+
+
+BT::InverterNode::InverterNode(std::string name) : DecoratorNode::DecoratorNode(name) {}
+BT::InverterNode::~InverterNode() {}
+BT::ReturnStatus BT::InverterNode::Tick()
+{
+	child_i_status_ = TickDecoratedChild();
+	if (child_i_status_ == BT::SUCCESS)
+	{
+		child_i_status_ = BT::FAILURE;
+	}
+	else if (child_i_status_ == BT::FAILURE)
+	{
+		child_i_status_ = BT::SUCCESS;
+	}
+	set_status(child_i_status_);
+	return child_i_status_;
+}
+
+
+
+BT::RetryNode::RetryNode(std::string name, unsigned int attempts) : DecoratorNode::DecoratorNode(name), failures_(0)
+{
+	set_attempts(attempts);
+}
+BT::RetryNode::~RetryNode() {}
+BT::ReturnStatus BT::RetryNode::Tick()
+{
+	while (true)
+	{
+		child_i_status_ = TickDecoratedChild();
+		if (child_i_status_ == BT::FAILURE)
+		{
+			failures_++;
+			if (failures_ < attempts_)
+			{
+				// the child is idle again: it is ticked from the beginning
+				continue;
+			}
+		}
+		if (child_i_status_ != BT::RUNNING)
+		{
+			failures_ = 0;
+		}
+		set_status(child_i_status_);
+		return child_i_status_;
+	}
+}
+void BT::RetryNode::Halt()
+{
+	failures_ = 0;
+	ControlNode::Halt();
+}
+void BT::RetryNode::set_attempts(unsigned int attempts)
+{
+	if (attempts == 0)
+	{
+		throw std::invalid_argument("a retry node needs at least one attempt");
+	}
+	attempts_ = attempts;
+}
+unsigned int BT::RetryNode::get_attempts()
+{
+	return attempts_;
+}
+
+
+
+BT::TimeoutNode::TimeoutNode(std::string name, std::chrono::nanoseconds timeout) : DecoratorNode::DecoratorNode(name),
+	timeout_(timeout), is_child_running_(false) {}
+BT::TimeoutNode::~TimeoutNode() {}
+BT::ReturnStatus BT::TimeoutNode::Tick()
+{
+	Clock::time_point now = GetDefaultClock()->now();
+	if (!is_child_running_)
+	{
+		deadline_ = now + timeout_;
+	}
+	else if (now >= deadline_)
+	{
+		// An action may have returned its result since the last tick: it is taken below
+		ReturnStatus child_status = children_nodes_[0]->get_status();
+		if (child_status != BT::SUCCESS && child_status != BT::FAILURE)
+		{
+			BT_LOG_DEBUG(get_name().data(), "TIMED OUT, HALTING the child");
+			HaltChildren(0);
+			// the next tick starts the child again
+			children_nodes_[0]->set_status(BT::IDLE);
+			is_child_running_ = false;
+			set_status(BT::FAILURE);
+			return BT::FAILURE;
+		}
+	}
+
+	child_i_status_ = TickDecoratedChild();
+	is_child_running_ = (child_i_status_ == BT::RUNNING);
+	set_status(child_i_status_);
+	return child_i_status_;
+}
+void BT::TimeoutNode::Halt()
+{
+	is_child_running_ = false;
+	ControlNode::Halt();
+}
+void BT::TimeoutNode::set_timeout(std::chrono::nanoseconds timeout)
+{
+	timeout_ = timeout;
+}
+std::chrono::nanoseconds BT::TimeoutNode::get_timeout()
+{
+	return timeout_;
+}
+
+
+
+BT::RateLimitNode::RateLimitNode(std::string name, double frequency_hz) : DecoratorNode::DecoratorNode(name),
+	last_status_(BT::IDLE), has_last_status_(false), skipped_ticks_(0)
+{
+	set_frequency(frequency_hz);
+}
+BT::RateLimitNode::~RateLimitNode() {}
+BT::ReturnStatus BT::RateLimitNode::Tick()
+{
+	Clock::time_point now = GetDefaultClock()->now();
+	if (has_last_status_ && now < next_tick_)
+	{
+		skipped_ticks_++;
+		set_status(last_status_);
+		return last_status_;
+	}
+
+	next_tick_ = now + period_;
+	last_status_ = TickDecoratedChild();
+	has_last_status_ = true;
+	set_status(last_status_);
+	return last_status_;
+}
+void BT::RateLimitNode::Halt()
+{
+	// the next tick reaches the child
+	has_last_status_ = false;
+	ControlNode::Halt();
+}
+void BT::RateLimitNode::set_frequency(double frequency_hz)
+{
+	if (!(frequency_hz > 0.0))
+	{
+		throw std::invalid_argument("the frequency of a rate limit node must be positive");
+	}
+	period_ = std::chrono::nanoseconds((long long)(1e9 / frequency_hz));
+}
+double BT::RateLimitNode::get_frequency()
+{
+	return 1e9 / period_.count();
+}
+unsigned long long BT::RateLimitNode::GetSkippedTicksNumber()
+{
+	return skipped_ticks_;
+}
+
+
+
+BT::CooldownNode::CooldownNode(std::string name, std::chrono::nanoseconds cooldown) : DecoratorNode::DecoratorNode(name),
+	cooldown_(cooldown) {}
+BT::CooldownNode::~CooldownNode() {}
+BT::ReturnStatus BT::CooldownNode::Tick()
+{
+	if (GetDefaultClock()->now() < ready_time_)
+	{
+		set_status(BT::FAILURE);
+		return BT::FAILURE;
+	}
+
+	child_i_status_ = TickDecoratedChild();
+	if (child_i_status_ == BT::SUCCESS || child_i_status_ == BT::FAILURE)
+	{
+		// the cooldown starts when the child completes
+		ready_time_ = GetDefaultClock()->now() + cooldown_;
+	}
+	set_status(child_i_status_);
+	return child_i_status_;
+}
+void BT::CooldownNode::Reset()
+{
+	ready_time_ = Clock::time_point();
+}
+void BT::CooldownNode::set_cooldown(std::chrono::nanoseconds cooldown)
+{
+	cooldown_ = cooldown;
+}
+std::chrono::nanoseconds BT::CooldownNode::get_cooldown()
+{
+	return cooldown_;
+}
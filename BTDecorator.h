@@ -0,0 +1,127 @@
+#pragma once
+#include"BTs.h"
+#include"BTClock.h"
+#include <chrono>
+
+
+namespace BT
+{
+	// Control node with exactly one child, which changes how the child is ticked or what
+	// it returns. The child is ticked like the child of any control node (an action runs
+	// on the executor), and it goes in idle once its result has been used.
+	class DecoratorNode : public ControlNode
+	{
+	protected:
+		// Ticks the child and returns its status
+		ReturnStatus TickDecoratedChild();
+
+	public:
+		DecoratorNode(std::string name);
+		~DecoratorNode();
+
+		// Throws std::logic_error if the decorator already has a child
+		void AddChild(TreeNode* child);
+
+		// The child, nullptr if it has not been added yet
+		TreeNode* get_child();
+		int DrawType();
+	};
+
+
+	// Returns FAILURE when the child succeeds and SUCCESS when it fails
+	class InverterNode : public DecoratorNode
+	{
+	public:
+		InverterNode(std::string name);
+		~InverterNode();
+		BT::ReturnStatus Tick();
+	};
+
+
+	// Ticks the child again, in the same tick, when it fails, up to the given number of
+	// attempts. Returns FAILURE only when all the attempts have failed.
+	class RetryNode : public DecoratorNode
+	{
+	private:
+		unsigned int attempts_;
+		unsigned int failures_;
+
+	public:
+		RetryNode(std::string name, unsigned int attempts = 3);
+		~RetryNode();
+		BT::ReturnStatus Tick();
+		void Halt();
+
+		void set_attempts(unsigned int attempts);
+		unsigned int get_attempts();
+	};
+
+
+	// Halts the child and returns FAILURE if it is still running after the timeout.
+	// The time is counted from the tick that started the child; the deadline is checked
+	// at every tick of the decorator, so it is enforced with the resolution of the tick period.
+	// A result the child has returned between two ticks is taken, even past the deadline.
+	class TimeoutNode : public DecoratorNode
+	{
+	private:
+		std::chrono::nanoseconds timeout_;
+		Clock::time_point deadline_;
+		bool is_child_running_;
+
+	public:
+		TimeoutNode(std::string name, std::chrono::nanoseconds timeout);
+		~TimeoutNode();
+		BT::ReturnStatus Tick();
+		void Halt();
+
+		void set_timeout(std::chrono::nanoseconds timeout);
+		std::chrono::nanoseconds get_timeout();
+	};
+
+
+	// Ticks the child at most frequency_hz times per second; the ticks in between return
+	// the status of the last tick of the child without ticking it.
+	// Used to run a heavy subtree at a lower rate than the root.
+	class RateLimitNode : public DecoratorNode
+	{
+	private:
+		std::chrono::nanoseconds period_;
+		Clock::time_point next_tick_;
+		ReturnStatus last_status_;
+		bool has_last_status_;
+		unsigned long long skipped_ticks_;
+
+	public:
+		RateLimitNode(std::string name, double frequency_hz);
+		~RateLimitNode();
+		BT::ReturnStatus Tick();
+		void Halt();
+
+		void set_frequency(double frequency_hz);
+		double get_frequency();
+
+		// Number of ticks answered without ticking the child
+		unsigned long long GetSkippedTicksNumber();
+	};
+
+
+	// After the child has returned SUCCESS or FAILURE, returns FAILURE without ticking
+	// the child until the cooldown has elapsed.
+	class CooldownNode : public DecoratorNode
+	{
+	private:
+		std::chrono::nanoseconds cooldown_;
+		Clock::time_point ready_time_;
+
+	public:
+		CooldownNode(std::string name, std::chrono::nanoseconds cooldown);
+		~CooldownNode();
+		BT::ReturnStatus Tick();
+
+		// Makes the child tickable again at once
+		void Reset();
+
+		void set_cooldown(std::chrono::nanoseconds cooldown);
+		std::chrono::nanoseconds get_cooldown();
+	};
+};
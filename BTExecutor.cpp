@@ -0,0 +1,185 @@
+#include"BTExecutor.h"
+
+
+namespace
+{
+	// Index of the calling worker in its pool (used to push locally)
+	thread_local BT::ThreadPool* current_pool = nullptr;
+	thread_local unsigned int current_worker = 0;
+
+	std::atomic<BT::Executor*> default_executor(nullptr);
+}
+
+
+BT::ThreadPool::ThreadPool(unsigned int n_of_workers) : pending_tasks_(0), next_queue_(0), is_stopping_(false)
+{
+	if (n_of_workers == 0)
+	{
+		n_of_workers = std::thread::hardware_concurrency();
+	}
+	if (n_of_workers == 0)
+	{
+		n_of_workers = 1;
+	}
+
+	for (unsigned int i = 0; i < n_of_workers; i++)
+	{
+		queues_.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+	for (unsigned int i = 0; i < n_of_workers; i++)
+	{
+		workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+}
+BT::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> LockGuard(sleep_mutex_);
+		is_stopping_ = true;
+	}
+	sleep_condition_variable_.notify_all();
+
+	for (unsigned int i = 0; i < workers_.size(); i++)
+	{
+		workers_[i].join();
+	}
+}
+void BT::ThreadPool::Submit(std::function<void()> task)
+{
+	// A worker submitting a task keeps it in its own deque, the other threads
+	// spread the tasks round robin
+	unsigned int index;
+	if (current_pool == this)
+	{
+		index = current_worker;
+	}
+	else
+	{
+		index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> LockGuard(queues_[index]->mutex_);
+		queues_[index]->tasks_.push_back(std::move(task));
+	}
+	pending_tasks_.fetch_add(1);
+
+	// Taking the lock before notifying avoids losing the wakeup of a worker
+	// that has just checked pending_tasks_
+	{
+		std::lock_guard<std::mutex> LockGuard(sleep_mutex_);
+	}
+	sleep_condition_variable_.notify_one();
+}
+unsigned int BT::ThreadPool::GetWorkersNumber()
+{
+	return workers_.size();
+}
+bool BT::ThreadPool::TryPop(unsigned int index, std::function<void()>& task)
+{
+	// 1) own deque, newest task first
+	{
+		std::lock_guard<std::mutex> LockGuard(queues_[index]->mutex_);
+		if (!queues_[index]->tasks_.empty())
+		{
+			task = std::move(queues_[index]->tasks_.back());
+			queues_[index]->tasks_.pop_back();
+			return true;
+		}
+	}
+
+	// 2) steal the oldest task of another worker
+	for (unsigned int k = 1; k < queues_.size(); k++)
+	{
+		WorkerQueue& victim = *queues_[(index + k) % queues_.size()];
+		std::unique_lock<std::mutex> UniqueLock(victim.mutex_, std::try_to_lock);
+		if (UniqueLock.owns_lock() && !victim.tasks_.empty())
+		{
+			task = std::move(victim.tasks_.front());
+			victim.tasks_.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+BT::ThreadPolicyResult BT::ThreadPool::SetThreadPolicy(const ThreadPolicy& policy)
+{
+	ThreadPolicyResult result = ThreadPolicyResult();
+	result.is_affinity_applied = true;
+	result.is_priority_applied = true;
+	result.is_name_applied = true;
+
+	for (unsigned int i = 0; i < workers_.size(); i++)
+	{
+		ThreadPolicy worker_policy;
+		if (!policy.cpus.empty())
+		{
+			worker_policy.cpus.push_back(policy.cpus[i % policy.cpus.size()]);
+		}
+		worker_policy.priority = policy.priority;
+		if (!policy.name.empty())
+		{
+			worker_policy.name = policy.name + "-" + std::to_string(i);
+		}
+
+		ThreadPolicyResult worker_result = ApplyThreadPolicy(workers_[i], worker_policy);
+		result.is_affinity_applied = result.is_affinity_applied && worker_result.is_affinity_applied;
+		result.is_priority_applied = result.is_priority_applied && worker_result.is_priority_applied;
+		result.is_name_applied = result.is_name_applied && worker_result.is_name_applied;
+		if (result.error == 0 && !worker_result.is_applied())
+		{
+			result.error = worker_result.error;
+			result.message = worker_result.message;
+		}
+	}
+	return result;
+}
+void BT::ThreadPool::WorkerLoop(unsigned int index)
+{
+	current_pool = this;
+	current_worker = index;
+
+	std::function<void()> task;
+	while (true)
+	{
+		if (TryPop(index, task))
+		{
+			pending_tasks_.fetch_sub(1);
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> UniqueLock(sleep_mutex_);
+		if (pending_tasks_.load() > 0)
+		{
+			// a task is queued but its deque was locked by someone else: retry
+			continue;
+		}
+		if (is_stopping_)
+		{
+			return;
+		}
+		sleep_condition_variable_.wait(UniqueLock);
+	}
+}
+
+
+BT::Executor* BT::GetDefaultExecutor()
+{
+	BT::Executor* executor = default_executor.load();
+	if (executor == nullptr)
+	{
+		// Created on first use and never destroyed: the action nodes may still
+		// submit ticks while static objects are being destroyed
+		static BT::ThreadPool* pool = new BT::ThreadPool();
+		BT::Executor* expected = nullptr;
+		default_executor.compare_exchange_strong(expected, pool);
+		executor = default_executor.load();
+	}
+	return executor;
+}
+void BT::SetDefaultExecutor(Executor* executor)
+{
+	default_executor.store(executor);
+}
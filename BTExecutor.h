@@ -0,0 +1,80 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include"BTThreading.h"
+
+
+namespace BT
+{
+	// Abstract executor used to run the Tick() of the action nodes as tasks.
+	// Any implementation must run every submitted task exactly once.
+	class Executor
+	{
+	public:
+		virtual ~Executor() {}
+
+		// The method used to schedule a task
+		virtual void Submit(std::function<void()> task) = 0;
+
+		// The number of threads that execute the tasks
+		virtual unsigned int GetWorkersNumber() = 0;
+	};
+
+
+	// Bounded, work-stealing thread pool.
+	// Every worker owns a deque: it pops its own tasks from the back (LIFO) and,
+	// when its deque is empty, steals from the front of the other deques (FIFO).
+	// The number of threads is fixed at construction, so the memory use and the
+	// context switches depend on the number of workers and not on the tree size.
+	// A task that blocks (e.g. an action that sleeps) keeps its worker busy.
+	class ThreadPool : public Executor
+	{
+	private:
+		struct WorkerQueue
+		{
+			std::mutex mutex_;
+			std::deque<std::function<void()>> tasks_;
+		};
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues_;
+		std::vector<std::thread> workers_;
+
+		// Used to park the workers when there is nothing to run
+		std::mutex sleep_mutex_;
+		std::condition_variable sleep_condition_variable_;
+
+		// Number of tasks queued and not yet taken by a worker
+		std::atomic<unsigned int> pending_tasks_;
+		std::atomic<unsigned int> next_queue_;
+		std::atomic<bool> is_stopping_;
+
+		void WorkerLoop(unsigned int index);
+		bool TryPop(unsigned int index, std::function<void()>& task);
+
+	public:
+		// n_of_workers == 0 means one worker per hardware thread
+		ThreadPool(unsigned int n_of_workers = 0);
+
+		// Runs the tasks still queued and joins the workers
+		~ThreadPool();
+
+		void Submit(std::function<void()> task);
+		unsigned int GetWorkersNumber();
+
+		// Applies the policy to the workers: the worker i is pinned to cpus[i % cpus.size()]
+		// and named "<name>-<i>". The result tells what could be applied to all of them.
+		ThreadPolicyResult SetThreadPolicy(const ThreadPolicy& policy);
+	};
+
+
+	// The executor used by the action nodes that have not been given one.
+	// Unless it is replaced, it is a ThreadPool sized to the core count.
+	Executor* GetDefaultExecutor();
+	void SetDefaultExecutor(Executor* executor);
+};
@@ -0,0 +1,357 @@
+#include"BTLoader.h"
+#include"BTDecorator.h"
+#include"BTAdaptive.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	const char kMagic[4] = { 'B', 'T', 'R', 'E' };
+	const unsigned int kVersion = 1;
+
+	// Appends the string to the table, once
+	unsigned int InternString(const std::string& value, std::vector<char>& strings, std::unordered_map<std::string, unsigned int>& offsets)
+	{
+		std::unordered_map<std::string, unsigned int>::iterator it = offsets.find(value);
+		if (it != offsets.end())
+		{
+			return it->second;
+		}
+		unsigned int offset = strings.size();
+		strings.insert(strings.end(), value.begin(), value.end());
+		strings.push_back('\0');
+		offsets[value] = offset;
+		return offset;
+	}
+
+	void Append(std::vector<char>& image, const void* data, size_t size)
+	{
+		const char* bytes = static_cast<const char*>(data);
+		image.insert(image.end(), bytes, bytes + size);
+	}
+
+	std::runtime_error SyntaxError(unsigned int line_number, const std::string& message)
+	{
+		return std::runtime_error("tree text, line " + std::to_string(line_number) + ": " + message);
+	}
+
+	std::string ReadFile(const std::string& file_path)
+	{
+		std::ifstream file(file_path.c_str(), std::ios::binary);
+		if (!file)
+		{
+			throw std::runtime_error("cannot read " + file_path);
+		}
+		std::ostringstream content;
+		content << file.rdbuf();
+		return content.str();
+	}
+}
+
+
+BT::NodeFactory::NodeFactory()
+{
+	Register<SequenceNode>("Sequence");
+	Register<SelectorNode>("Selector");
+	Register<ParallelNode>("Parallel");
+	Register<InverterNode>("Inverter");
+	Register<AdaptiveSelectorNode>("AdaptiveSelector");
+}
+void BT::NodeFactory::Register(const std::string& type_name, NodeBuilder builder)
+{
+	builders_[type_name] = builder;
+}
+bool BT::NodeFactory::is_registered(const std::string& type_name) const
+{
+	return builders_.find(type_name) != builders_.end();
+}
+BT::NodeBuilder BT::NodeFactory::GetBuilder(const std::string& type_name) const
+{
+	std::unordered_map<std::string, NodeBuilder>::const_iterator it = builders_.find(type_name);
+	return (it != builders_.end()) ? it->second : nullptr;
+}
+BT::TreeNode* BT::NodeFactory::Create(const std::string& type_name, const std::string& name, TreeArena* arena) const
+{
+	NodeBuilder builder = GetBuilder(type_name);
+	if (builder == nullptr)
+	{
+		throw std::invalid_argument("unknown node type '" + type_name + "'");
+	}
+	return builder(name, arena);
+}
+
+
+std::vector<char> BT::CompileTextTree(const std::string& text)
+{
+	std::vector<unsigned int> type_names;
+	std::unordered_map<std::string, unsigned int> types;
+	std::vector<BinaryTreeNode> nodes;
+	std::vector<char> strings;
+	std::unordered_map<std::string, unsigned int> string_offsets;
+
+	// Indentation and index of the fathers of the current line
+	std::vector<std::pair<size_t, unsigned int> > fathers;
+
+	std::istringstream lines(text);
+	std::string line;
+	unsigned int line_number = 0;
+	while (std::getline(lines, line))
+	{
+		line_number++;
+		if (!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+		size_t indentation = line.find_first_not_of(" \t");
+		if (indentation == std::string::npos || line[indentation] == '#')
+		{
+			continue;
+		}
+
+		// "<type> <name>": the name is the rest of the line, the type if it is missing
+		size_t type_end = line.find_first_of(" \t", indentation);
+		std::string type_name = line.substr(indentation, type_end - indentation);
+		std::string name = type_name;
+		if (type_end != std::string::npos)
+		{
+			size_t name_begin = line.find_first_not_of(" \t", type_end);
+			size_t name_end = line.find_last_not_of(" \t");
+			if (name_begin != std::string::npos)
+			{
+				name = line.substr(name_begin, name_end + 1 - name_begin);
+			}
+		}
+
+		while (!fathers.empty() && fathers.back().first >= indentation)
+		{
+			fathers.pop_back();
+		}
+		if (fathers.empty() && !nodes.empty())
+		{
+			throw SyntaxError(line_number, "a tree has one root, '" + name + "' is not indented under it");
+		}
+		if (!fathers.empty())
+		{
+			nodes[fathers.back().second].children_number++;
+		}
+
+		BinaryTreeNode node;
+		std::unordered_map<std::string, unsigned int>::iterator type = types.find(type_name);
+		if (type == types.end())
+		{
+			type = types.insert(std::make_pair(type_name, (unsigned int)type_names.size())).first;
+			type_names.push_back(InternString(type_name, strings, string_offsets));
+		}
+		node.type = type->second;
+		node.name = InternString(name, strings, string_offsets);
+		node.children_number = 0;
+
+		fathers.push_back(std::make_pair(indentation, (unsigned int)nodes.size()));
+		nodes.push_back(node);
+	}
+	if (nodes.empty())
+	{
+		throw SyntaxError(line_number, "the tree is empty");
+	}
+
+	BinaryTreeHeader header;
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.types_number = type_names.size();
+	header.nodes_number = nodes.size();
+	header.strings_size = strings.size();
+
+	std::vector<char> image;
+	image.reserve(sizeof(header) + type_names.size() * sizeof(unsigned int) + nodes.size() * sizeof(BinaryTreeNode) + strings.size());
+	Append(image, &header, sizeof(header));
+	Append(image, type_names.data(), type_names.size() * sizeof(unsigned int));
+	Append(image, nodes.data(), nodes.size() * sizeof(BinaryTreeNode));
+	Append(image, strings.data(), strings.size());
+	return image;
+}
+
+BT::TreeNode* BT::LoadBinaryTree(const char* data, size_t size, const NodeFactory& factory, TreeArena* arena)
+{
+	BinaryTreeHeader header;
+	if (size < sizeof(header))
+	{
+		throw std::runtime_error("tree image: truncated header");
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+	{
+		throw std::runtime_error("tree image: not a version 1 binary tree");
+	}
+	unsigned long long expected_size = sizeof(header) + (unsigned long long)header.types_number * sizeof(unsigned int)
+		+ (unsigned long long)header.nodes_number * sizeof(BinaryTreeNode) + header.strings_size;
+	if (header.nodes_number == 0 || size < expected_size)
+	{
+		throw std::runtime_error("tree image: truncated or empty");
+	}
+
+	// The sections are copied out field by field: the image may not be aligned
+	const char* type_names = data + sizeof(header);
+	const char* nodes = type_names + header.types_number * sizeof(unsigned int);
+	const char* strings = nodes + header.nodes_number * sizeof(BinaryTreeNode);
+	if (header.strings_size == 0 || strings[header.strings_size - 1] != '\0')
+	{
+		throw std::runtime_error("tree image: unterminated strings");
+	}
+
+	// Every type is resolved once
+	std::vector<NodeBuilder> builders(header.types_number);
+	for (unsigned int t = 0; t < header.types_number; t++)
+	{
+		unsigned int offset;
+		std::memcpy(&offset, type_names + t * sizeof(unsigned int), sizeof(offset));
+		if (offset >= header.strings_size)
+		{
+			throw std::runtime_error("tree image: bad type name");
+		}
+		builders[t] = factory.GetBuilder(strings + offset);
+		if (builders[t] == nullptr)
+		{
+			throw std::invalid_argument("unknown node type '" + std::string(strings + offset) + "'");
+		}
+	}
+
+	// Checks the structure before creating any node
+	unsigned long long pending = 1;
+	for (unsigned int i = 0; i < header.nodes_number; i++)
+	{
+		BinaryTreeNode node;
+		std::memcpy(&node, nodes + i * sizeof(BinaryTreeNode), sizeof(node));
+		if (pending == 0 || node.type >= header.types_number || node.name >= header.strings_size)
+		{
+			throw std::runtime_error("tree image: bad node " + std::to_string(i));
+		}
+		pending += node.children_number;
+		pending--;
+	}
+	if (pending != 0)
+	{
+		throw std::runtime_error("tree image: missing nodes");
+	}
+
+	// Fathers still waiting for children, with the number of children missing
+	std::vector<std::pair<ControlNode*, unsigned int> > fathers;
+	TreeNode* root = nullptr;
+	// A node created but not in the tree yet (its father may refuse it)
+	TreeNode* detached_node = nullptr;
+	try
+	{
+		for (unsigned int i = 0; i < header.nodes_number; i++)
+		{
+			BinaryTreeNode description;
+			std::memcpy(&description, nodes + i * sizeof(BinaryTreeNode), sizeof(description));
+
+			TreeNode* node = builders[description.type](strings + description.name, arena);
+			if (fathers.empty())
+			{
+				root = node;
+			}
+			else
+			{
+				detached_node = node;
+				fathers.back().first->AddChild(node);
+				detached_node = nullptr;
+				fathers.back().second--;
+			}
+
+			if (description.children_number > 0)
+			{
+				ControlNode* control_node = dynamic_cast<ControlNode*>(node);
+				if (control_node == nullptr)
+				{
+					throw std::invalid_argument("'" + std::string(node->get_name()) + "' has children but it is not a control node");
+				}
+				control_node->ReserveChildren(description.children_number);
+				fathers.push_back(std::make_pair(control_node, description.children_number));
+			}
+			while (!fathers.empty() && fathers.back().second == 0)
+			{
+				fathers.pop_back();
+			}
+		}
+	}
+	catch (...)
+	{
+		// The nodes created so far are in the partial tree, but the one its father has
+		// refused (an arena releases its own)
+		if (arena == nullptr)
+		{
+			delete detached_node;
+			if (root != nullptr)
+			{
+				DestroyTree(root);
+			}
+		}
+		throw;
+	}
+	return root;
+}
+
+BT::TreeNode* BT::LoadTreeFile(const std::string& file_path, const NodeFactory& factory, TreeArena* arena)
+{
+#if defined(_WIN32)
+	std::string image = ReadFile(file_path);
+	return LoadBinaryTree(image.data(), image.size(), factory, arena);
+#else
+	int file = open(file_path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		throw std::runtime_error("cannot read " + file_path);
+	}
+	struct stat file_status;
+	if (fstat(file, &file_status) != 0 || file_status.st_size == 0)
+	{
+		close(file);
+		throw std::runtime_error("cannot read " + file_path);
+	}
+	size_t size = file_status.st_size;
+	void* image = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (image == MAP_FAILED)
+	{
+		throw std::runtime_error("cannot map " + file_path);
+	}
+
+	TreeNode* root;
+	try
+	{
+		root = LoadBinaryTree(static_cast<const char*>(image), size, factory, arena);
+	}
+	catch (...)
+	{
+		munmap(image, size);
+		throw;
+	}
+	munmap(image, size);
+	return root;
+#endif
+}
+
+BT::TreeNode* BT::LoadTextTreeFile(const std::string& file_path, const NodeFactory& factory, TreeArena* arena)
+{
+	std::vector<char> image = CompileTextTree(ReadFile(file_path));
+	return LoadBinaryTree(image.data(), image.size(), factory, arena);
+}
+
+void BT::ConvertTreeFile(const std::string& text_file_path, const std::string& binary_file_path)
+{
+	std::vector<char> image = CompileTextTree(ReadFile(text_file_path));
+	std::ofstream file(binary_file_path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file.write(image.data(), image.size()))
+	{
+		throw std::runtime_error("cannot write " + binary_file_path);
+	}
+}
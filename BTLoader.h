@@ -0,0 +1,101 @@
+#pragma once
+#include"BTs.h"
+#include"BTArena.h"
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+
+namespace BT
+{
+	// Creates a node with the given name, in the arena if one is given
+	typedef TreeNode* (*NodeBuilder)(const std::string& name, TreeArena* arena);
+
+	// Registry of the node types a tree file can use, by type name.
+	// "Sequence", "Selector", "Parallel" (SUCCEED_ON_ALL, FAIL_ON_ONE), "Inverter" and
+	// "AdaptiveSelector" (all the children reorderable) are registered by the constructor;
+	// the user conditions and actions are added with Register<T>().
+	class NodeFactory
+	{
+	private:
+		std::unordered_map<std::string, NodeBuilder> builders_;
+
+		template <class T>
+		static TreeNode* Build(const std::string& name, TreeArena* arena)
+		{
+			if (arena != nullptr)
+			{
+				return arena->Create<T>(name);
+			}
+			return new T(name);
+		}
+
+	public:
+		NodeFactory();
+
+		// Registers (or replaces) a type; T must be constructible from its name
+		template <class T>
+		void Register(const std::string& type_name)
+		{
+			Register(type_name, &NodeFactory::Build<T>);
+		}
+		void Register(const std::string& type_name, NodeBuilder builder);
+
+		bool is_registered(const std::string& type_name) const;
+
+		// Returns the builder of the type, nullptr if it is not registered
+		NodeBuilder GetBuilder(const std::string& type_name) const;
+
+		// Creates a node: throws std::invalid_argument if the type is not registered
+		TreeNode* Create(const std::string& type_name, const std::string& name, TreeArena* arena = nullptr) const;
+	};
+
+	// Binary tree file ("BTRE" version 1, native byte order):
+	//   BinaryTreeHeader
+	//   unsigned int type_names[types_number]     offsets of the type names in the strings
+	//   BinaryTreeNode nodes[nodes_number]         the nodes in pre-order
+	//   char strings[strings_size]                 null-terminated names
+	// A node is followed by the subtrees of its children_number children, so the file
+	// is loaded with one linear pass and every type name is resolved only once.
+	struct BinaryTreeHeader
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int types_number;
+		unsigned int nodes_number;
+		unsigned int strings_size;
+	};
+
+	struct BinaryTreeNode
+	{
+		unsigned int type;
+		unsigned int name;
+		unsigned int children_number;
+	};
+
+	// Text tree file: one node per line, "<type> <name>", the children indented under their
+	// father (with tabs or spaces, consistently); empty lines and lines starting with '#'
+	// are ignored. For example:
+	//   Sequence root
+	//       MyCondition is_ready
+	//       Selector choose
+	//           MyAction act
+	// Converts a text tree to the binary format: throws std::runtime_error on a syntax error
+	std::vector<char> CompileTextTree(const std::string& text);
+
+	// Builds the tree described by a binary image. Throws std::runtime_error if the image
+	// is malformed and std::invalid_argument if it uses a type that is not registered
+	// or gives children to a node that is not a control node. On any error (a builder
+	// may throw too), the nodes already created are freed.
+	// With an arena, all the nodes are created in it and released with it.
+	TreeNode* LoadBinaryTree(const char* data, size_t size, const NodeFactory& factory, TreeArena* arena = nullptr);
+
+	// Maps the binary tree file in memory and builds the tree
+	TreeNode* LoadTreeFile(const std::string& file_path, const NodeFactory& factory, TreeArena* arena = nullptr);
+
+	// Reads a text tree file, converts it and builds the tree
+	TreeNode* LoadTextTreeFile(const std::string& file_path, const NodeFactory& factory, TreeArena* arena = nullptr);
+
+	// Converts a text tree file to a binary tree file
+	void ConvertTreeFile(const std::string& text_file_path, const std::string& binary_file_path);
+};
@@ -0,0 +1,226 @@
+#include"BTLog.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace
+{
+	struct LogRecord
+	{
+		long long timestamp_ns;
+		unsigned long long thread_hash;
+		int level;
+		char tag[BT::Logger::kTagSize];
+		char message[BT::Logger::kMessageSize];
+	};
+
+	// Bounded multi-producer, single-consumer ring: every slot has a sequence number telling
+	// whether it is free for the producer of position p (== p) or full for the consumer (== p + 1)
+	struct LogSlot
+	{
+		std::atomic<unsigned long long> sequence;
+		LogRecord record;
+	};
+
+	const unsigned int kRingCapacity = 4096;
+
+	class LogRing
+	{
+	public:
+		LogSlot slots[kRingCapacity];
+		std::atomic<unsigned long long> tail;
+		unsigned long long head;
+		std::atomic<unsigned long long> dropped;
+
+		std::mutex consumer_mutex;
+		std::condition_variable consumer_condition_variable;
+		std::thread consumer;
+		std::once_flag consumer_started;
+		bool is_stopping;
+
+		std::mutex sink_mutex;
+		FILE* sink;
+
+		LogRing() : tail(0), head(0), dropped(0), is_stopping(false), sink(stdout)
+		{
+			for (unsigned int i = 0; i < kRingCapacity; i++)
+			{
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	const std::chrono::steady_clock::time_point log_epoch = std::chrono::steady_clock::now();
+
+	// Never destroyed: the actions may still log while the static objects are destroyed
+	LogRing& GetRing()
+	{
+		static LogRing* ring = new LogRing();
+		return *ring;
+	}
+
+	const char* LevelName(int level)
+	{
+		switch (level)
+		{
+		case BT::LOG_DEBUG: return "DEBUG";
+		case BT::LOG_INFO: return "INFO";
+		case BT::LOG_WARNING: return "WARNING";
+		default: return "ERROR";
+		}
+	}
+
+	// Writes the available records; called with the consumer_mutex held
+	void Drain(LogRing& ring)
+	{
+		std::lock_guard<std::mutex> LockGuard(ring.sink_mutex);
+		bool has_written = false;
+		while (true)
+		{
+			LogSlot& slot = ring.slots[ring.head % kRingCapacity];
+			if (slot.sequence.load(std::memory_order_acquire) != ring.head + 1)
+			{
+				break;
+			}
+			const LogRecord& record = slot.record;
+			std::fprintf(ring.sink, "[%12.6f] %-7s [%04llx] %s: %s\n", record.timestamp_ns / 1e9,
+				LevelName(record.level), record.thread_hash & 0xFFFF, record.tag, record.message);
+			has_written = true;
+
+			// frees the slot for the producers of the next round
+			slot.sequence.store(ring.head + kRingCapacity, std::memory_order_release);
+			ring.head++;
+		}
+		if (has_written)
+		{
+			std::fflush(ring.sink);
+		}
+	}
+
+	void ConsumerLoop()
+	{
+		LogRing& ring = GetRing();
+		std::unique_lock<std::mutex> UniqueLock(ring.consumer_mutex);
+		while (!ring.is_stopping)
+		{
+			Drain(ring);
+
+			// The producers do not notify (it would take a lock): the ring is polled
+			ring.consumer_condition_variable.wait_for(UniqueLock, std::chrono::milliseconds(5));
+		}
+		Drain(ring);
+	}
+
+	void StopConsumer()
+	{
+		LogRing& ring = GetRing();
+		{
+			std::lock_guard<std::mutex> LockGuard(ring.consumer_mutex);
+			ring.is_stopping = true;
+		}
+		ring.consumer_condition_variable.notify_all();
+		if (ring.consumer.joinable())
+		{
+			ring.consumer.join();
+		}
+	}
+
+	void StartConsumer()
+	{
+		LogRing& ring = GetRing();
+		ring.consumer = std::thread(ConsumerLoop);
+		std::atexit(StopConsumer);
+	}
+}
+
+
+std::atomic<int> BT::Logger::level_(BT::LOG_INFO);
+
+void BT::Logger::set_level(LogLevel level)
+{
+	level_.store(level);
+}
+BT::LogLevel BT::Logger::get_level()
+{
+	return (LogLevel)level_.load();
+}
+bool BT::Logger::set_file(const std::string& file_path)
+{
+	FILE* file = std::fopen(file_path.c_str(), "a");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	LogRing& ring = GetRing();
+	std::lock_guard<std::mutex> LockGuard(ring.sink_mutex);
+	if (ring.sink != stdout)
+	{
+		std::fclose(ring.sink);
+	}
+	ring.sink = file;
+	return true;
+}
+void BT::Logger::Write(LogLevel level, const char* tag, const char* format, ...)
+{
+	LogRing& ring = GetRing();
+	std::call_once(ring.consumer_started, StartConsumer);
+
+	// Claims a slot
+	unsigned long long position = ring.tail.load(std::memory_order_relaxed);
+	LogSlot* slot;
+	while (true)
+	{
+		slot = &ring.slots[position % kRingCapacity];
+		unsigned long long sequence = slot->sequence.load(std::memory_order_acquire);
+		long long difference = (long long)(sequence - position);
+		if (difference == 0)
+		{
+			if (ring.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// full
+			ring.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			position = ring.tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Formats in place
+	LogRecord& record = slot->record;
+	record.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - log_epoch).count();
+	record.thread_hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+	record.level = level;
+	std::strncpy(record.tag, tag, kTagSize - 1);
+	record.tag[kTagSize - 1] = '\0';
+
+	va_list arguments;
+	va_start(arguments, format);
+	std::vsnprintf(record.message, kMessageSize, format, arguments);
+	va_end(arguments);
+
+	// Publishes the record to the consumer
+	slot->sequence.store(position + 1, std::memory_order_release);
+}
+void BT::Logger::Flush()
+{
+	LogRing& ring = GetRing();
+	std::lock_guard<std::mutex> LockGuard(ring.consumer_mutex);
+	Drain(ring);
+}
+unsigned long long BT::Logger::GetDroppedNumber()
+{
+	return GetRing().dropped.load();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+
+namespace BT
+{
+	// Enumerates the severity levels of the log; "LOG_OFF" disables it
+	enum LogLevel { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERROR, LOG_OFF };
+
+	// Asynchronous logger for the tick path.
+	// Write() formats the message (printf-like) directly into a slot of a bounded lock-free
+	// ring: no allocation, no lock and no I/O in the calling thread. A background thread
+	// writes the records to the sink (stdout by default). When the ring is full the
+	// message is dropped and counted, the caller never waits.
+	// The background thread starts with the first message; Flush() is called at exit.
+	class Logger
+	{
+	private:
+		static std::atomic<int> level_;
+
+	public:
+		// Sizes of a record
+		static const unsigned int kTagSize = 32;
+		static const unsigned int kMessageSize = 200;
+
+		static void set_level(LogLevel level);
+		static LogLevel get_level();
+		static bool is_enabled(LogLevel level)
+		{
+			return level >= level_.load(std::memory_order_relaxed);
+		}
+
+		// Sends the records to a file instead of stdout; returns false if it cannot be opened
+		static bool set_file(const std::string& file_path);
+
+		// Queues a message, tagged for instance with the name of the node
+		static void Write(LogLevel level, const char* tag, const char* format, ...)
+#if defined(__GNUC__)
+			__attribute__((format(printf, 3, 4)))
+#endif
+			;
+
+		// Blocks until the queued records have been written
+		static void Flush();
+
+		// Number of messages dropped because the ring was full
+		static unsigned long long GetDroppedNumber();
+	};
+};
+
+
+// The arguments are evaluated only when the level is enabled
+#define BT_LOG(level, tag, ...) do { if (BT::Logger::is_enabled(level)) { BT::Logger::Write(level, tag, __VA_ARGS__); } } while (0)
+#define BT_LOG_DEBUG(tag, ...) BT_LOG(BT::LOG_DEBUG, tag, __VA_ARGS__)
+#define BT_LOG_INFO(tag, ...) BT_LOG(BT::LOG_INFO, tag, __VA_ARGS__)
+#define BT_LOG_WARNING(tag, ...) BT_LOG(BT::LOG_WARNING, tag, __VA_ARGS__)
+#define BT_LOG_ERROR(tag, ...) BT_LOG(BT::LOG_ERROR, tag, __VA_ARGS__)
@@ -0,0 +1,491 @@
+#include"BTReplay.h"
+#include"BTTrace.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace
+{
+	const char kMagic[4] = { 'B', 'T', 'R', 'C' };
+	const unsigned int kVersion = 1;
+	const unsigned char kUnknownStatus = 0xFF;
+
+	// Pre-order, as the nodes of the record file
+	void CollectNodes(BT::TreeNode* node, std::vector<BT::TreeNode*>& nodes, std::unordered_map<BT::TreeNode*, unsigned int>& indices)
+	{
+		indices[node] = nodes.size();
+		nodes.push_back(node);
+		if (node->get_type() == BT::CONTROL_NODE)
+		{
+			const std::vector<BT::TreeNode*>& children = static_cast<BT::ControlNode*>(node)->GetChildren();
+			for (unsigned int i = 0; i < children.size(); i++)
+			{
+				CollectNodes(children[i], nodes, indices);
+			}
+		}
+	}
+
+	void AppendVarint(std::vector<unsigned char>& buffer, unsigned long long value)
+	{
+		while (value >= 0x80)
+		{
+			buffer.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		buffer.push_back((unsigned char)value);
+	}
+
+	void Append(std::vector<unsigned char>& buffer, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	unsigned long long ReadVarint(const unsigned char*& data, const unsigned char* end)
+	{
+		unsigned long long value = 0;
+		for (unsigned int shift = 0; shift < 64; shift += 7)
+		{
+			if (data == end)
+			{
+				break;
+			}
+			unsigned char byte = *data++;
+			value |= (unsigned long long)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+		throw std::runtime_error("tree record: bad varint");
+	}
+
+	unsigned char ReadByte(const unsigned char*& data, const unsigned char* end)
+	{
+		if (data == end)
+		{
+			throw std::runtime_error("tree record: truncated frame");
+		}
+		return *data++;
+	}
+
+	void SkipChanges(const unsigned char*& data, const unsigned char* end)
+	{
+		unsigned long long changes_number = ReadVarint(data, end);
+		for (unsigned long long i = 0; i < changes_number; i++)
+		{
+			ReadVarint(data, end);
+			ReadByte(data, end);
+		}
+	}
+
+	// Restores the hook of the thread, also when the tick throws
+	struct HookGuard
+	{
+		BT::TickHook*& current;
+		BT::TickHook* previous;
+
+		HookGuard(BT::TickHook*& current_hook, BT::TickHook* hook) : current(current_hook), previous(current_hook)
+		{
+			current = hook;
+		}
+		~HookGuard()
+		{
+			current = previous;
+		}
+	};
+}
+
+
+thread_local BT::TickHook* BT::TickHook::current_ = nullptr;
+
+BT::ReturnStatus BT::TickHook::TickRoot(TreeNode* root, TickHook* hook)
+{
+	HookGuard guard(current_, hook);
+	hook->BeginFrame();
+
+	std::chrono::steady_clock::time_point tick_start = std::chrono::steady_clock::now();
+	BT_TRACE_TICK_BEGIN(root);
+	ReturnStatus root_status = root->Tick();
+	BT_TRACE_TICK_END(root, root_status);
+	std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - tick_start;
+
+	hook->EndFrame(root_status, duration.count());
+	return root_status;
+}
+
+
+
+BT::TreeRecorder::TreeRecorder(TreeNode* root, const std::string& file_path) : root_(root), events_number_(0), frames_(0), bytes_(0)
+{
+	CollectNodes(root, nodes_, indices_);
+	statuses_.assign(nodes_.size(), kUnknownStatus);
+
+	file_ = std::fopen(file_path.c_str(), "wb");
+	if (file_ == nullptr)
+	{
+		throw std::runtime_error("cannot write " + file_path);
+	}
+
+	std::vector<unsigned char> header;
+	unsigned int nodes_number = nodes_.size();
+	Append(header, kMagic, sizeof(kMagic));
+	Append(header, &kVersion, sizeof(kVersion));
+	Append(header, &nodes_number, sizeof(nodes_number));
+	for (unsigned int i = 0; i < nodes_.size(); i++)
+	{
+		std::string_view name = nodes_[i]->get_name();
+		header.push_back((unsigned char)nodes_[i]->get_type());
+		AppendVarint(header, name.size());
+		Append(header, name.data(), name.size());
+	}
+	std::fwrite(header.data(), 1, header.size(), file_);
+	bytes_ = header.size();
+}
+BT::TreeRecorder::~TreeRecorder()
+{
+	std::fclose(file_);
+}
+BT::ReturnStatus BT::TreeRecorder::Tick()
+{
+	return TickHook::TickRoot(root_, this);
+}
+void BT::TreeRecorder::Flush()
+{
+	std::fflush(file_);
+}
+unsigned long long BT::TreeRecorder::GetFramesNumber()
+{
+	return frames_;
+}
+unsigned long long BT::TreeRecorder::GetBytesWritten()
+{
+	return bytes_;
+}
+void BT::TreeRecorder::AppendChanges(std::vector<unsigned char>& buffer, bool is_leaves_only)
+{
+	// Only the statuses that changed: most of the tree is untouched by a tick.
+	// Each status is read once, an action may change it meanwhile.
+	changes_.clear();
+	unsigned int changes_number = 0;
+	for (unsigned int i = 0; i < nodes_.size(); i++)
+	{
+		unsigned char status = (unsigned char)nodes_[i]->get_status();
+		if ((!is_leaves_only || nodes_[i]->get_type() != BT::CONTROL_NODE) && statuses_[i] != status)
+		{
+			AppendVarint(changes_, i);
+			changes_.push_back(status);
+			statuses_[i] = status;
+			changes_number++;
+		}
+	}
+	AppendVarint(buffer, changes_number);
+	buffer.insert(buffer.end(), changes_.begin(), changes_.end());
+}
+bool BT::TreeRecorder::is_replacing_leaves()
+{
+	return false;
+}
+bool BT::TreeRecorder::BeforeLeafTick(TreeNode* leaf, ReturnStatus& status)
+{
+	(void)leaf;
+	(void)status;
+	return false;
+}
+void BT::TreeRecorder::AfterLeafTick(TreeNode* leaf, ReturnStatus status)
+{
+	std::unordered_map<TreeNode*, unsigned int>::iterator it = indices_.find(leaf);
+	if (it == indices_.end())
+	{
+		// added to the tree after the recorder was created
+		return;
+	}
+	events_.push_back(BT::RECORD_LEAF);
+	AppendVarint(events_, it->second);
+	events_.push_back((unsigned char)status);
+	events_number_++;
+}
+bool BT::TreeRecorder::BeforeHalt(TreeNode* node)
+{
+	std::unordered_map<TreeNode*, unsigned int>::iterator it = indices_.find(node);
+	if (it != indices_.end())
+	{
+		events_.push_back(BT::RECORD_HALT);
+		AppendVarint(events_, it->second);
+		events_number_++;
+	}
+	return false;
+}
+void BT::TreeRecorder::BeginFrame()
+{
+	events_.clear();
+	events_number_ = 0;
+
+	// The actions that have returned between two ticks, on their own threads
+	start_changes_.clear();
+	AppendChanges(start_changes_, true);
+}
+void BT::TreeRecorder::EndFrame(ReturnStatus root_status, unsigned long long duration_ns)
+{
+	frame_.clear();
+	AppendVarint(frame_, duration_ns);
+	frame_.push_back((unsigned char)root_status);
+	frame_.insert(frame_.end(), start_changes_.begin(), start_changes_.end());
+	AppendVarint(frame_, events_number_);
+	frame_.insert(frame_.end(), events_.begin(), events_.end());
+	AppendChanges(frame_, false);
+
+	unsigned int frame_size = frame_.size();
+	std::fwrite(&frame_size, sizeof(frame_size), 1, file_);
+	std::fwrite(frame_.data(), 1, frame_.size(), file_);
+	bytes_ += sizeof(frame_size) + frame_.size();
+	frames_++;
+}
+
+
+
+BT::TreeReplayer::TreeReplayer(TreeNode* root, const std::string& file_path) : root_(root), position_(0),
+	start_changes_(nullptr), events_(nullptr), events_end_(nullptr), end_changes_(nullptr), frame_end_(nullptr), recorded_status_(BT::IDLE),
+	recorded_duration_ns_(0), is_diverging_(false), frames_(0), divergent_frames_(0), first_divergent_frame_(-1)
+{
+	CollectNodes(root, nodes_, indices_);
+	statuses_.assign(nodes_.size(), kUnknownStatus);
+
+	std::ifstream file(file_path.c_str(), std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("cannot read " + file_path);
+	}
+	std::ostringstream content;
+	content << file.rdbuf();
+	std::string bytes = content.str();
+	record_.assign(bytes.begin(), bytes.end());
+
+	const unsigned char* data = record_.data();
+	const unsigned char* end = data + record_.size();
+	unsigned int version;
+	unsigned int nodes_number;
+	if (record_.size() < sizeof(kMagic) + sizeof(version) + sizeof(nodes_number))
+	{
+		throw std::runtime_error("tree record: truncated header");
+	}
+	std::memcpy(&version, data + sizeof(kMagic), sizeof(version));
+	std::memcpy(&nodes_number, data + sizeof(kMagic) + sizeof(version), sizeof(nodes_number));
+	if (std::memcmp(data, kMagic, sizeof(kMagic)) != 0 || version != kVersion)
+	{
+		throw std::runtime_error("tree record: not a version 1 record");
+	}
+	if (nodes_number != nodes_.size())
+	{
+		throw std::runtime_error("tree record: " + std::to_string(nodes_number) + " nodes recorded, the tree has " + std::to_string(nodes_.size()));
+	}
+
+	data += sizeof(kMagic) + sizeof(version) + sizeof(nodes_number);
+	for (unsigned int i = 0; i < nodes_number; i++)
+	{
+		unsigned char type = ReadByte(data, end);
+		unsigned long long name_size = ReadVarint(data, end);
+		if (name_size > (unsigned long long)(end - data))
+		{
+			throw std::runtime_error("tree record: truncated header");
+		}
+		std::string_view name((const char*)data, name_size);
+		data += name_size;
+		if (type != (unsigned char)nodes_[i]->get_type() || name != nodes_[i]->get_name())
+		{
+			throw std::runtime_error("tree record: node " + std::to_string(i) + " '" + std::string(name) + "' does not match '" + std::string(nodes_[i]->get_name()) + "'");
+		}
+	}
+	position_ = data - record_.data();
+}
+BT::TreeReplayer::~TreeReplayer() {}
+bool BT::TreeReplayer::Step()
+{
+	unsigned int frame_size;
+	if (record_.size() - position_ < sizeof(frame_size))
+	{
+		return false;
+	}
+	std::memcpy(&frame_size, record_.data() + position_, sizeof(frame_size));
+	if (record_.size() - position_ - sizeof(frame_size) < frame_size)
+	{
+		// cut by the end of the recording
+		return false;
+	}
+
+	const unsigned char* data = record_.data() + position_ + sizeof(frame_size);
+	frame_end_ = data + frame_size;
+	recorded_duration_ns_ = ReadVarint(data, frame_end_);
+	recorded_status_ = (ReturnStatus)ReadByte(data, frame_end_);
+	start_changes_ = data;
+	SkipChanges(data, frame_end_);
+	unsigned long long events_number = ReadVarint(data, frame_end_);
+	events_ = data;
+	for (unsigned long long i = 0; i < events_number; i++)
+	{
+		if (ReadByte(data, frame_end_) == BT::RECORD_LEAF)
+		{
+			ReadVarint(data, frame_end_);
+			ReadByte(data, frame_end_);
+		}
+		else
+		{
+			ReadVarint(data, frame_end_);
+		}
+	}
+	events_end_ = data;
+	end_changes_ = data;
+	SkipChanges(data, frame_end_);
+
+	TickHook::TickRoot(root_, this);
+	position_ += sizeof(frame_size) + frame_size;
+	return true;
+}
+unsigned long long BT::TreeReplayer::Run()
+{
+	unsigned long long frames = 0;
+	while (Step())
+	{
+		frames++;
+	}
+	return frames;
+}
+unsigned int BT::TreeReplayer::ReadNodeIndex(const unsigned char*& data)
+{
+	unsigned long long index = ReadVarint(data, frame_end_);
+	if (index >= nodes_.size())
+	{
+		throw std::runtime_error("tree record: bad node " + std::to_string(index));
+	}
+	return index;
+}
+void BT::TreeReplayer::Diverge()
+{
+	is_diverging_ = true;
+}
+unsigned long long BT::TreeReplayer::GetFramesNumber()
+{
+	return frames_;
+}
+unsigned long long BT::TreeReplayer::GetDivergentFramesNumber()
+{
+	return divergent_frames_;
+}
+long long BT::TreeReplayer::GetFirstDivergentFrame()
+{
+	return first_divergent_frame_;
+}
+BT::ReturnStatus BT::TreeReplayer::get_recorded_status()
+{
+	return recorded_status_;
+}
+unsigned long long BT::TreeReplayer::get_recorded_duration_ns()
+{
+	return recorded_duration_ns_;
+}
+bool BT::TreeReplayer::is_replacing_leaves()
+{
+	return true;
+}
+bool BT::TreeReplayer::BeforeLeafTick(TreeNode* leaf, ReturnStatus& status)
+{
+	const unsigned char* data = events_;
+	if (data != events_end_ && *data == BT::RECORD_LEAF)
+	{
+		data++;
+		std::unordered_map<TreeNode*, unsigned int>::iterator it = indices_.find(leaf);
+		if (it != indices_.end() && ReadVarint(data, events_end_) == it->second)
+		{
+			status = (ReturnStatus)ReadByte(data, events_end_);
+			events_ = data;
+			return true;
+		}
+	}
+
+	// Not the recorded leaf: it fails, without consuming the recorded event
+	Diverge();
+	status = BT::FAILURE;
+	return true;
+}
+void BT::TreeReplayer::AfterLeafTick(TreeNode* leaf, ReturnStatus status)
+{
+	(void)leaf;
+	(void)status;
+}
+bool BT::TreeReplayer::BeforeHalt(TreeNode* node)
+{
+	const unsigned char* data = events_;
+	std::unordered_map<TreeNode*, unsigned int>::iterator it = indices_.find(node);
+	if (data != events_end_ && *data == BT::RECORD_HALT && it != indices_.end())
+	{
+		data++;
+		if (ReadVarint(data, events_end_) == it->second)
+		{
+			events_ = data;
+		}
+		else
+		{
+			Diverge();
+		}
+	}
+	else
+	{
+		Diverge();
+	}
+
+	// The control nodes halt their children as usual, the leaves are never reached
+	return node->get_type() != BT::CONTROL_NODE;
+}
+void BT::TreeReplayer::BeginFrame()
+{
+	is_diverging_ = false;
+
+	// The leaves take the statuses they had when the tick started
+	const unsigned char* data = start_changes_;
+	unsigned long long changes_number = ReadVarint(data, frame_end_);
+	for (unsigned long long i = 0; i < changes_number; i++)
+	{
+		unsigned int index = ReadNodeIndex(data);
+		statuses_[index] = ReadByte(data, frame_end_);
+		nodes_[index]->set_status((ReturnStatus)statuses_[index]);
+	}
+}
+void BT::TreeReplayer::EndFrame(ReturnStatus root_status, unsigned long long duration_ns)
+{
+	(void)duration_ns;
+	if (events_ != events_end_ || root_status != recorded_status_)
+	{
+		Diverge();
+	}
+
+	const unsigned char* data = end_changes_;
+	unsigned long long changes_number = ReadVarint(data, frame_end_);
+	for (unsigned long long i = 0; i < changes_number; i++)
+	{
+		unsigned int index = ReadNodeIndex(data);
+		statuses_[index] = ReadByte(data, frame_end_);
+	}
+
+	// The leaves are compared through their events: the status of an action at the end
+	// of a recorded tick depends on the timing of its thread
+	for (unsigned int i = 0; i < nodes_.size(); i++)
+	{
+		if (nodes_[i]->get_type() == BT::CONTROL_NODE && statuses_[i] != (unsigned char)nodes_[i]->get_status())
+		{
+			Diverge();
+			break;
+		}
+	}
+
+	if (is_diverging_)
+	{
+		divergent_frames_++;
+		if (first_divergent_frame_ < 0)
+		{
+			first_divergent_frame_ = frames_;
+		}
+	}
+	frames_++;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include"BTs.h"
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace BT
+{
+	// Observes, or replaces, what the fathers do with the leaves during the ticks made by the
+	// calling thread: ControlNode::TickChild() and the parallel node call it for every leaf
+	// they tick, ControlNode::HaltChildren() for every node it halts. It is installed by TickRoot().
+	class TickHook
+	{
+	private:
+		static thread_local TickHook* current_;
+
+	public:
+		virtual ~TickHook() {}
+
+		// The hook of the calling thread, nullptr outside TickRoot()
+		static TickHook* get_current() { return current_; }
+
+		// Ticks the root once with the hook installed on the calling thread
+		static ReturnStatus TickRoot(TreeNode* root, TickHook* hook);
+
+		// True if BeforeLeafTick() gives the results: the leaves are then never really ticked
+		virtual bool is_replacing_leaves() = 0;
+
+		// Called before a leaf is ticked; returns true, with its status, to skip the real tick
+		virtual bool BeforeLeafTick(TreeNode* leaf, ReturnStatus& status) = 0;
+		virtual void AfterLeafTick(TreeNode* leaf, ReturnStatus status) = 0;
+
+		// Called before a running node is halted; returns true to skip the real halt of a leaf
+		virtual bool BeforeHalt(TreeNode* node) = 0;
+
+		// Called by TickRoot() around the tick of the root
+		virtual void BeginFrame() = 0;
+		virtual void EndFrame(ReturnStatus root_status, unsigned long long duration_ns) = 0;
+	};
+
+
+	// Tree record file ("BTRC" version 1, native byte order, the counts and indices as varints):
+	//   char magic[4], unsigned int version, unsigned int nodes_number
+	//   per node, in pre-order: type, name length, name
+	//   frames, one per root tick: unsigned int frame_size, then
+	//     tick duration in ns, root status,
+	//     start changes: the leaves whose status has changed since the previous frame
+	//     events_number, events: RECORD_LEAF node status | RECORD_HALT node
+	//     end changes: the nodes whose status differs from the previous frame
+	//   a list of changes is changes_number, then node status for each
+	// The frames are only appended: a frame cut by a crash is ignored by the replay.
+	enum RecordEventType { RECORD_LEAF, RECORD_HALT };
+
+	// Records the ticks of a tree: the results of the leaves and the halts, in the order
+	// of the tick, and the statuses of all the nodes at the end of each tick.
+	// Tick() replaces root->Tick() in the loop that drives the tree.
+	class TreeRecorder : public TickHook
+	{
+	private:
+		TreeNode* root_;
+		std::vector<TreeNode*> nodes_;
+		std::unordered_map<TreeNode*, unsigned int> indices_;
+		// Status of every node at the end of the last frame
+		std::vector<unsigned char> statuses_;
+		std::FILE* file_;
+
+		std::vector<unsigned char> start_changes_;
+		std::vector<unsigned char> events_;
+		unsigned int events_number_;
+		std::vector<unsigned char> changes_;
+		std::vector<unsigned char> frame_;
+		unsigned long long frames_;
+		unsigned long long bytes_;
+
+		// Appends the statuses that differ from the table, and updates it
+		void AppendChanges(std::vector<unsigned char>& buffer, bool is_leaves_only);
+
+	public:
+		// Creates the file: throws std::runtime_error if it cannot be written
+		TreeRecorder(TreeNode* root, const std::string& file_path);
+		~TreeRecorder();
+
+		ReturnStatus Tick();
+
+		// Writes the buffered frames to the file
+		void Flush();
+		unsigned long long GetFramesNumber();
+		unsigned long long GetBytesWritten();
+
+		bool is_replacing_leaves();
+		bool BeforeLeafTick(TreeNode* leaf, ReturnStatus& status);
+		void AfterLeafTick(TreeNode* leaf, ReturnStatus status);
+		bool BeforeHalt(TreeNode* node);
+		void BeginFrame();
+		void EndFrame(ReturnStatus root_status, unsigned long long duration_ns);
+	};
+
+
+	// Replays a record on a tree with the same structure (types and names, in pre-order).
+	// The leaves are not ticked nor halted: they return the recorded results and take the
+	// statuses recorded at the start of each tick (an action can finish between two ticks),
+	// so only the logic of the control nodes runs, as fast as it can. A frame diverges if the tree asks
+	// for a leaf or a halt other than the recorded one, if a leaf remains unasked, or if the
+	// root or a control node ends the tick with another status than the recorded one.
+	class TreeReplayer : public TickHook
+	{
+	private:
+		TreeNode* root_;
+		std::vector<TreeNode*> nodes_;
+		std::unordered_map<TreeNode*, unsigned int> indices_;
+		// Recorded status of every node at the end of the last frame
+		std::vector<unsigned char> statuses_;
+		std::vector<unsigned char> record_;
+		size_t position_;
+
+		// The frame being replayed
+		const unsigned char* start_changes_;
+		const unsigned char* events_;
+		const unsigned char* events_end_;
+		const unsigned char* end_changes_;
+		const unsigned char* frame_end_;
+		ReturnStatus recorded_status_;
+		unsigned long long recorded_duration_ns_;
+		bool is_diverging_;
+
+		unsigned long long frames_;
+		unsigned long long divergent_frames_;
+		long long first_divergent_frame_;
+
+		unsigned int ReadNodeIndex(const unsigned char*& data);
+		void Diverge();
+
+	public:
+		// Reads the whole record: throws std::runtime_error if it cannot be read, is malformed
+		// or does not match the tree
+		TreeReplayer(TreeNode* root, const std::string& file_path);
+		~TreeReplayer();
+
+		// Replays the next frame; returns false at the end of the record
+		bool Step();
+
+		// Replays all the remaining frames and returns their number
+		unsigned long long Run();
+
+		unsigned long long GetFramesNumber();
+		unsigned long long GetDivergentFramesNumber();
+		// Index of the first divergent frame, -1 if none
+		long long GetFirstDivergentFrame();
+
+		// Root status and tick duration recorded for the last replayed frame
+		ReturnStatus get_recorded_status();
+		unsigned long long get_recorded_duration_ns();
+
+		bool is_replacing_leaves();
+		bool BeforeLeafTick(TreeNode* leaf, ReturnStatus& status);
+		void AfterLeafTick(TreeNode* leaf, ReturnStatus status);
+		bool BeforeHalt(TreeNode* node);
+		void BeginFrame();
+		void EndFrame(ReturnStatus root_status, unsigned long long duration_ns);
+	};
+};
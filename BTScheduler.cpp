@@ -0,0 +1,303 @@
+#include"BTScheduler.h"
+#include"BTTrace.h"
+#include"BTClock.h"
+#include <cmath>
+
+
+BT::TickScheduler::TickScheduler(TreeNode* root, std::chrono::nanoseconds period, OverrunPolicy overrun_policy)
+	: root_(root), is_running_(false), has_thread_policy_(false), thread_policy_result_(), has_next_root_(false), next_root_(nullptr), swaps_(0), is_background_stopping_(false)
+{
+	blackboard_ = nullptr;
+	snapshot_publisher_ = nullptr;
+	period_ = period;
+	overrun_policy_ = overrun_policy;
+	ResetStatistics();
+}
+BT::TickScheduler::~TickScheduler()
+{
+	Stop();
+
+	// The background thread finishes its tasks (the builds included) before it returns
+	{
+		std::lock_guard<std::mutex> LockGuard(background_mutex_);
+		is_background_stopping_ = true;
+	}
+	background_condition_variable_.notify_all();
+	if (background_thread_.joinable())
+	{
+		background_thread_.join();
+	}
+
+	// Frees the trees owned: a root never swapped in, and the current one if it was
+	if (has_next_root_.load())
+	{
+		HaltTree(next_root_);
+		next_dispose_(next_root_);
+	}
+	if (root_dispose_)
+	{
+		HaltTree(root_.load());
+		root_dispose_(root_.load());
+	}
+}
+void BT::TickScheduler::Start()
+{
+	if (thread_.joinable())
+	{
+		return;
+	}
+	is_running_ = true;
+	thread_ = std::thread(&TickScheduler::Loop, this);
+}
+void BT::TickScheduler::Run()
+{
+	is_running_ = true;
+	Loop();
+}
+void BT::TickScheduler::Loop()
+{
+	if (has_thread_policy_)
+	{
+		ThreadPolicyResult result = ApplyThreadPolicy(thread_policy_);
+		std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+		thread_policy_result_ = result;
+	}
+
+	// The deadlines are on the clock of the engine, which may be simulated:
+	// the time then runs only while the loop waits for the next deadline
+	Clock* clock = GetDefaultClock();
+	clock->BeginActivity();
+	Clock::ActivityScope scope;
+	Clock::time_point deadline = clock->now();
+	while (is_running_)
+	{
+		Clock::time_point tick_start = clock->now();
+		if (has_next_root_.load(std::memory_order_acquire))
+		{
+			// tick boundary: the new root is ticked from now on
+			SwapPendingRoot();
+		}
+		if (blackboard_ != nullptr)
+		{
+			// all the nodes see the same values during the tick
+			blackboard_->Publish();
+		}
+		TreeNode* root = root_.load(std::memory_order_relaxed);
+		BT_TRACE_TICK_BEGIN(root);
+		ReturnStatus root_status = root->Tick();
+		BT_TRACE_TICK_END(root, root_status);
+		Clock::time_point tick_end = clock->now();
+		if (snapshot_publisher_ != nullptr)
+		{
+			// the viewers see the tree as the tick left it
+			snapshot_publisher_->Publish(root);
+		}
+
+		RecordTick(std::chrono::duration<double, std::micro>(tick_start - deadline).count(),
+			std::chrono::duration<double, std::micro>(tick_end - tick_start).count());
+
+		deadline += period_;
+		if (tick_end > deadline)
+		{
+			// The tick ended after the next deadline
+			std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+			statistics_.overruns++;
+
+			if (overrun_policy_ == BT::SKIP_MISSED_TICKS)
+			{
+				unsigned long long missed = (tick_end - deadline) / period_ + 1;
+				deadline += missed * period_;
+				statistics_.skipped_ticks += missed;
+			}
+		}
+
+		// Waits for the deadline (or for Stop())
+		std::unique_lock<std::mutex> UniqueLock(stop_mutex_);
+		clock->WaitUntil(UniqueLock, stop_condition_variable_, deadline, [this]() { return !is_running_; });
+	}
+	clock->EndActivity();
+}
+void BT::TickScheduler::Stop()
+{
+	{
+		std::lock_guard<std::mutex> LockGuard(stop_mutex_);
+		is_running_ = false;
+	}
+	stop_condition_variable_.notify_all();
+
+	if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id())
+	{
+		thread_.join();
+	}
+}
+bool BT::TickScheduler::is_running()
+{
+	return is_running_;
+}
+void BT::TickScheduler::RecordTick(double jitter_us, double tick_us)
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+
+	if (statistics_.ticks == 0 || jitter_us < statistics_.min_jitter_us)
+	{
+		statistics_.min_jitter_us = jitter_us;
+	}
+	if (statistics_.ticks == 0 || jitter_us > statistics_.max_jitter_us)
+	{
+		statistics_.max_jitter_us = jitter_us;
+	}
+	if (tick_us > statistics_.max_tick_us)
+	{
+		statistics_.max_tick_us = tick_us;
+	}
+	statistics_.ticks++;
+	jitter_sum_us_ += jitter_us;
+	jitter_square_sum_us_ += jitter_us * jitter_us;
+	tick_sum_us_ += tick_us;
+}
+BT::TickStatistics BT::TickScheduler::GetStatistics()
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+
+	TickStatistics statistics = statistics_;
+	if (statistics.ticks > 0)
+	{
+		double n = (double)statistics.ticks;
+		statistics.mean_jitter_us = jitter_sum_us_ / n;
+		statistics.stddev_jitter_us = std::sqrt(std::fmax(0.0, jitter_square_sum_us_ / n - statistics.mean_jitter_us * statistics.mean_jitter_us));
+		statistics.mean_tick_us = tick_sum_us_ / n;
+	}
+	return statistics;
+}
+void BT::TickScheduler::ResetStatistics()
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+
+	statistics_ = TickStatistics();
+	jitter_sum_us_ = 0.0;
+	jitter_square_sum_us_ = 0.0;
+	tick_sum_us_ = 0.0;
+}
+void BT::TickScheduler::set_blackboard(Blackboard* blackboard)
+{
+	blackboard_ = blackboard;
+}
+BT::Blackboard* BT::TickScheduler::get_blackboard()
+{
+	return blackboard_;
+}
+void BT::TickScheduler::set_snapshot_publisher(TreeSnapshotPublisher* snapshot_publisher)
+{
+	snapshot_publisher_ = snapshot_publisher;
+}
+BT::TreeSnapshotPublisher* BT::TickScheduler::get_snapshot_publisher()
+{
+	return snapshot_publisher_;
+}
+std::chrono::nanoseconds BT::TickScheduler::get_period()
+{
+	return period_;
+}
+BT::OverrunPolicy BT::TickScheduler::get_overrun_policy()
+{
+	return overrun_policy_;
+}
+void BT::TickScheduler::SwapRoot(TreeNode* new_root, TreeDisposer dispose)
+{
+	TreeNode* replaced_root = nullptr;
+	TreeDisposer replaced_dispose;
+	{
+		std::lock_guard<std::mutex> LockGuard(swap_mutex_);
+		if (has_next_root_.load())
+		{
+			// the root still waiting is replaced before it has been ticked
+			replaced_root = next_root_;
+			replaced_dispose.swap(next_dispose_);
+		}
+		next_root_ = new_root;
+		next_dispose_ = dispose;
+		has_next_root_.store(true, std::memory_order_release);
+	}
+	if (replaced_root != nullptr)
+	{
+		RunInBackground([replaced_root, replaced_dispose]() { replaced_dispose(replaced_root); });
+	}
+}
+void BT::TickScheduler::BuildAndSwapRoot(std::function<TreeNode*()> build, TreeDisposer dispose)
+{
+	RunInBackground([this, build, dispose]() { SwapRoot(build(), dispose); });
+}
+void BT::TickScheduler::SwapPendingRoot()
+{
+	TreeNode* old_root;
+	TreeDisposer dispose;
+	{
+		std::lock_guard<std::mutex> LockGuard(swap_mutex_);
+		old_root = root_.load();
+		dispose.swap(root_dispose_);
+		root_.store(next_root_);
+		root_dispose_.swap(next_dispose_);
+		next_root_ = nullptr;
+		has_next_root_.store(false);
+	}
+	swaps_++;
+
+	// The halt can wait for running actions: it is done off the tick loop
+	RunInBackground([old_root, dispose]()
+	{
+		HaltTree(old_root);
+		if (dispose)
+		{
+			dispose(old_root);
+		}
+	});
+}
+void BT::TickScheduler::RunInBackground(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> LockGuard(background_mutex_);
+		background_tasks_.push_back(task);
+		if (!background_thread_.joinable())
+		{
+			background_thread_ = std::thread(&TickScheduler::BackgroundLoop, this);
+		}
+	}
+	background_condition_variable_.notify_one();
+}
+void BT::TickScheduler::BackgroundLoop()
+{
+	std::unique_lock<std::mutex> UniqueLock(background_mutex_);
+	while (true)
+	{
+		background_condition_variable_.wait(UniqueLock, [this]() { return is_background_stopping_ || !background_tasks_.empty(); });
+		if (background_tasks_.empty())
+		{
+			// stopping, and all the trees have been freed
+			return;
+		}
+		std::function<void()> task = background_tasks_.front();
+		background_tasks_.pop_front();
+
+		UniqueLock.unlock();
+		task();
+		UniqueLock.lock();
+	}
+}
+void BT::TickScheduler::set_thread_policy(const ThreadPolicy& policy)
+{
+	thread_policy_ = policy;
+	has_thread_policy_ = true;
+}
+BT::ThreadPolicyResult BT::TickScheduler::GetThreadPolicyResult()
+{
+	std::lock_guard<std::mutex> LockGuard(statistics_mutex_);
+	return thread_policy_result_;
+}
+BT::TreeNode* BT::TickScheduler::get_root()
+{
+	return root_.load();
+}
+unsigned long long BT::TickScheduler::GetSwapsNumber()
+{
+	return swaps_.load();
+}
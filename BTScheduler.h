@@ -0,0 +1,148 @@
+#pragma once
+#include"BTs.h"
+#include"BTBlackboard.h"
+#include"BTThreading.h"
+#include"BTSnapshot.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace BT
+{
+	// Enumerates what the scheduler does when a tick ends after the next deadline:
+	// - "SKIP_MISSED_TICKS" drops the deadlines already passed and waits for the next one;
+	// - "CATCH_UP_MISSED_TICKS" ticks back to back until the missed deadlines are recovered.
+	enum OverrunPolicy { SKIP_MISSED_TICKS, CATCH_UP_MISSED_TICKS };
+
+	// Timing of the ticks since the start (or the last reset) of a scheduler.
+	// The jitter is the delay between a deadline and the start of its tick.
+	struct TickStatistics
+	{
+		unsigned long long ticks;
+		unsigned long long overruns;
+		unsigned long long skipped_ticks;
+
+		double min_jitter_us;
+		double max_jitter_us;
+		double mean_jitter_us;
+		double stddev_jitter_us;
+
+		double mean_tick_us;
+		double max_tick_us;
+	};
+
+	// Frees a tree that is no longer ticked
+	typedef std::function<void(TreeNode*)> TreeDisposer;
+
+	// Ticks a root at a fixed rate on absolute deadlines of the engine clock (GetDefaultClock()),
+	// so the period does not drift with the tick duration.
+	// The root can be replaced while ticking: the swap happens between two ticks, and the
+	// old tree is halted and freed on a background thread, away from the tick loop.
+	// The root given to the constructor stays owned by the caller; the roots swapped in
+	// are owned by the scheduler.
+	class TickScheduler
+	{
+	private:
+		std::atomic<TreeNode*> root_;
+		Blackboard* blackboard_;
+		TreeSnapshotPublisher* snapshot_publisher_;
+		std::chrono::nanoseconds period_;
+		OverrunPolicy overrun_policy_;
+
+		std::thread thread_;
+		std::atomic<bool> is_running_;
+
+		// Applied by the ticking thread before its first tick
+		bool has_thread_policy_;
+		ThreadPolicy thread_policy_;
+		ThreadPolicyResult thread_policy_result_;
+
+		// Used to interrupt the wait for the next deadline
+		std::mutex stop_mutex_;
+		std::condition_variable stop_condition_variable_;
+
+		std::mutex statistics_mutex_;
+		TickStatistics statistics_;
+		double jitter_sum_us_;
+		double jitter_square_sum_us_;
+		double tick_sum_us_;
+
+		// How to free the current root (empty if it is not owned), and the root waiting
+		// for the next tick boundary with its own disposer
+		TreeDisposer root_dispose_;
+		std::mutex swap_mutex_;
+		std::atomic<bool> has_next_root_;
+		TreeNode* next_root_;
+		TreeDisposer next_dispose_;
+		std::atomic<unsigned long long> swaps_;
+
+		// Thread that builds the new roots and halts and frees the old ones, started when needed
+		std::thread background_thread_;
+		std::mutex background_mutex_;
+		std::condition_variable background_condition_variable_;
+		std::deque<std::function<void()>> background_tasks_;
+		bool is_background_stopping_;
+
+		void Loop();
+		void RecordTick(double jitter_us, double tick_us);
+		void SwapPendingRoot();
+		void RunInBackground(std::function<void()> task);
+		void BackgroundLoop();
+
+	public:
+		// Constructor
+		TickScheduler(TreeNode* root, std::chrono::nanoseconds period, OverrunPolicy overrun_policy = SKIP_MISSED_TICKS);
+
+		// Stops the scheduler, joins its thread and frees the trees it owns
+		~TickScheduler();
+
+		// Ticks the root on a thread owned by the scheduler
+		void Start();
+
+		// Ticks the root on the calling thread until Stop() is called
+		void Run();
+
+		// Stops ticking after the current tick; joins the thread started by Start()
+		void Stop();
+		bool is_running();
+
+		TickStatistics GetStatistics();
+		void ResetStatistics();
+
+		// The blackboard published at the beginning of every tick (nullptr for none)
+		void set_blackboard(Blackboard* blackboard);
+		Blackboard* get_blackboard();
+
+		// The publisher of the tree state at the end of every tick (nullptr for none)
+		void set_snapshot_publisher(TreeSnapshotPublisher* snapshot_publisher);
+		TreeSnapshotPublisher* get_snapshot_publisher();
+
+		std::chrono::nanoseconds get_period();
+		OverrunPolicy get_overrun_policy();
+
+		// The affinity, priority and name of the ticking thread, set by Start() or Run()
+		// (with Run() the calling thread keeps them). To be called before starting.
+		void set_thread_policy(const ThreadPolicy& policy);
+
+		// What the ticking thread could apply; meaningful once it has started
+		ThreadPolicyResult GetThreadPolicyResult();
+
+		// Replaces the root at the next tick boundary and takes the ownership of new_root.
+		// When new_root is replaced in turn (or the scheduler is destroyed) it is halted with
+		// HaltTree() and given to dispose, on the background thread; by default it is deleted
+		// with DestroyTree(). For a tree in an arena, dispose can free the arena.
+		// The root it replaces is halted too, and disposed of only if it was swapped in.
+		void SwapRoot(TreeNode* new_root, TreeDisposer dispose = DestroyTree);
+
+		// Calls build on the background thread, then swaps the tree it returns in as SwapRoot()
+		void BuildAndSwapRoot(std::function<TreeNode*()> build, TreeDisposer dispose = DestroyTree);
+
+		TreeNode* get_root();
+		unsigned long long GetSwapsNumber();
+	};
+};
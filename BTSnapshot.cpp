@@ -0,0 +1,326 @@
+#include"BTSnapshot.h"
+#include"BTClock.h"
+#include"BTLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	const char kMagic[4] = { 'B', 'T', 'S', 'S' };
+	const unsigned int kVersion = 1;
+	const unsigned int kBuffersNumber = 3;
+
+	// The region is shared between processes: its atomics must not need a lock
+	static_assert(std::atomic<unsigned int>::is_always_lock_free, "the snapshot sequences must be lock-free");
+	static_assert(std::atomic<unsigned long long>::is_always_lock_free, "the snapshot counters must be lock-free");
+
+	// Offsets of the parts of the region
+	size_t InfosOffset()
+	{
+		return sizeof(BT::SnapshotHeader);
+	}
+	size_t StringsOffset(unsigned int nodes_capacity)
+	{
+		return InfosOffset() + nodes_capacity * sizeof(BT::SnapshotNodeInfo);
+	}
+	size_t BufferSize(unsigned int nodes_capacity)
+	{
+		size_t size = sizeof(BT::SnapshotBufferHeader) + nodes_capacity * sizeof(BT::SnapshotNodeState);
+		// each buffer starts on its own cache line
+		return (size + 63) & ~(size_t)63;
+	}
+	size_t BufferOffset(unsigned int nodes_capacity, unsigned int strings_capacity, unsigned int i)
+	{
+		size_t offset = (StringsOffset(nodes_capacity) + strings_capacity + 63) & ~(size_t)63;
+		return offset + i * BufferSize(nodes_capacity);
+	}
+
+	// Pre-order, with the parent and the depth of every node
+	void CollectLayout(BT::TreeNode* node, int parent, unsigned int depth, std::vector<BT::TreeNode*>& nodes,
+		std::vector<BT::SnapshotNodeInfo>& infos, std::string& strings)
+	{
+		BT::SnapshotNodeInfo info;
+		info.parent = parent;
+		info.name = strings.size();
+		info.depth = depth;
+		info.node_type = node->get_type();
+		info.draw_type = node->DrawType();
+		strings.append(node->get_name());
+		strings.push_back('\0');
+
+		int index = nodes.size();
+		nodes.push_back(node);
+		infos.push_back(info);
+		if (node->get_type() == BT::CONTROL_NODE)
+		{
+			const std::vector<BT::TreeNode*>& children = static_cast<BT::ControlNode*>(node)->GetChildren();
+			for (unsigned int i = 0; i < children.size(); i++)
+			{
+				CollectLayout(children[i], index, depth + 1, nodes, infos, strings);
+			}
+		}
+	}
+}
+
+
+BT::TreeSnapshotPublisher::TreeSnapshotPublisher(const std::string& name, unsigned int nodes_capacity, unsigned int strings_capacity)
+	: name_(name), region_(nullptr), region_size_(0), root_(nullptr), is_publishable_(false), is_layout_valid_(false)
+{
+#if defined(_WIN32)
+	throw std::runtime_error("the tree snapshots need POSIX shared memory");
+#else
+	region_size_ = BufferOffset(nodes_capacity, strings_capacity, kBuffersNumber);
+	int file = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (file < 0)
+	{
+		throw std::runtime_error("cannot create the shared memory " + name);
+	}
+	if (ftruncate(file, region_size_) != 0)
+	{
+		close(file);
+		shm_unlink(name.c_str());
+		throw std::runtime_error("cannot size the shared memory " + name);
+	}
+	void* region = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (region == MAP_FAILED)
+	{
+		shm_unlink(name.c_str());
+		throw std::runtime_error("cannot map the shared memory " + name);
+	}
+	region_ = static_cast<char*>(region);
+
+	// The region is zeroed by ftruncate(): the atomics start at 0
+	SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(region_);
+	header->version = kVersion;
+	header->nodes_capacity = nodes_capacity;
+	header->strings_capacity = strings_capacity;
+	header->latest.store(kBuffersNumber - 1);
+
+	// The magic goes last: a reader that sees it sees the capacities
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(header->magic, kMagic, sizeof(kMagic));
+#endif
+}
+BT::TreeSnapshotPublisher::~TreeSnapshotPublisher()
+{
+#if !defined(_WIN32)
+	munmap(region_, region_size_);
+	shm_unlink(name_.c_str());
+#endif
+}
+void BT::TreeSnapshotPublisher::Relayout(TreeNode* root)
+{
+	SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(region_);
+	std::vector<SnapshotNodeInfo> infos;
+	std::string strings;
+	nodes_.clear();
+	CollectLayout(root, -1, 0, nodes_, infos, strings);
+	root_ = root;
+
+	is_publishable_ = (nodes_.size() <= header->nodes_capacity && strings.size() <= header->strings_capacity);
+	if (!is_publishable_)
+	{
+		// The readers must not take the previous tree for this one: they see an empty layout
+		BT_LOG_WARNING("snapshot", "the tree of %u nodes does not fit in %s", (unsigned int)nodes_.size(), name_.c_str());
+		nodes_.clear();
+		infos.clear();
+		strings.clear();
+	}
+
+	// odd while it is rewritten
+	unsigned int sequence = header->layout_sequence.load(std::memory_order_relaxed);
+	header->layout_sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	header->nodes_number = nodes_.size();
+	header->strings_size = strings.size();
+	std::memcpy(region_ + InfosOffset(), infos.data(), infos.size() * sizeof(SnapshotNodeInfo));
+	std::memcpy(region_ + StringsOffset(header->nodes_capacity), strings.data(), strings.size());
+	header->layout_sequence.store(sequence + 2, std::memory_order_release);
+}
+void BT::TreeSnapshotPublisher::Publish(TreeNode* root)
+{
+	if (root != root_ || !is_layout_valid_.exchange(true))
+	{
+		Relayout(root);
+	}
+	if (!is_publishable_)
+	{
+		return;
+	}
+
+	SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(region_);
+	unsigned int index = (header->latest.load(std::memory_order_relaxed) + 1) % kBuffersNumber;
+	char* buffer = region_ + BufferOffset(header->nodes_capacity, header->strings_capacity, index);
+	SnapshotBufferHeader* buffer_header = reinterpret_cast<SnapshotBufferHeader*>(buffer);
+	SnapshotNodeState* states = reinterpret_cast<SnapshotNodeState*>(buffer + sizeof(SnapshotBufferHeader));
+
+	unsigned int sequence = buffer_header->sequence.load(std::memory_order_relaxed);
+	buffer_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	unsigned long long frame = header->frames.load(std::memory_order_relaxed);
+	buffer_header->layout_sequence = header->layout_sequence.load(std::memory_order_relaxed);
+	buffer_header->frame = frame;
+	// in the time of the scheduler, which may be simulated
+	buffer_header->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(GetDefaultClock()->now().time_since_epoch()).count();
+	for (unsigned int i = 0; i < nodes_.size(); i++)
+	{
+		// status and color status with one atomic load
+		NodeState state = nodes_[i]->get_state();
+		states[i].status = state.status;
+		states[i].color_status = state.color_status;
+		states[i].x_pose = nodes_[i]->get_x_pose();
+		states[i].x_shift = nodes_[i]->get_x_shift();
+	}
+
+	buffer_header->sequence.store(sequence + 2, std::memory_order_release);
+	header->latest.store(index, std::memory_order_release);
+	header->frames.store(frame + 1, std::memory_order_release);
+}
+void BT::TreeSnapshotPublisher::InvalidateLayout()
+{
+	is_layout_valid_.store(false);
+}
+unsigned long long BT::TreeSnapshotPublisher::GetFramesNumber()
+{
+	return reinterpret_cast<SnapshotHeader*>(region_)->frames.load();
+}
+
+
+
+BT::TreeSnapshotReader::TreeSnapshotReader(const std::string& name) : region_(nullptr), region_size_(0), layout_sequence_(0)
+{
+#if defined(_WIN32)
+	throw std::runtime_error("the tree snapshots need POSIX shared memory");
+#else
+	int file = shm_open(name.c_str(), O_RDONLY, 0);
+	if (file < 0)
+	{
+		throw std::runtime_error("cannot open the shared memory " + name);
+	}
+	struct stat file_status;
+	if (fstat(file, &file_status) != 0 || (size_t)file_status.st_size < sizeof(SnapshotHeader))
+	{
+		close(file);
+		throw std::runtime_error("cannot read the shared memory " + name);
+	}
+	region_size_ = file_status.st_size;
+	void* region = mmap(nullptr, region_size_, PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (region == MAP_FAILED)
+	{
+		throw std::runtime_error("cannot map the shared memory " + name);
+	}
+	region_ = static_cast<const char*>(region);
+
+	const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(region_);
+	if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion
+		|| BufferOffset(header->nodes_capacity, header->strings_capacity, kBuffersNumber) > region_size_)
+	{
+		munmap(const_cast<char*>(region_), region_size_);
+		throw std::runtime_error(name + " is not a version 1 tree snapshot region");
+	}
+#endif
+}
+BT::TreeSnapshotReader::~TreeSnapshotReader()
+{
+#if !defined(_WIN32)
+	munmap(const_cast<char*>(region_), region_size_);
+#endif
+}
+bool BT::TreeSnapshotReader::ReadLayout()
+{
+	const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(region_);
+	unsigned int sequence = header->layout_sequence.load(std::memory_order_acquire);
+	if (sequence == 0 || (sequence & 1) != 0)
+	{
+		return false;
+	}
+
+	unsigned int nodes_number = std::min(header->nodes_number, header->nodes_capacity);
+	unsigned int strings_size = std::min(header->strings_size, header->strings_capacity);
+	infos_.resize(nodes_number);
+	std::memcpy(infos_.data(), region_ + InfosOffset(), nodes_number * sizeof(SnapshotNodeInfo));
+	strings_.assign(region_ + StringsOffset(header->nodes_capacity), strings_size);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (header->layout_sequence.load(std::memory_order_relaxed) != sequence)
+	{
+		return false;
+	}
+	layout_sequence_ = sequence;
+	return true;
+}
+bool BT::TreeSnapshotReader::Read(TreeSnapshot& snapshot)
+{
+	const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(region_);
+	std::vector<SnapshotNodeState> states;
+
+	// A few attempts: the publisher only rewrites a buffer two frames after it was the latest
+	for (unsigned int attempt = 0; attempt < 4; attempt++)
+	{
+		if (header->frames.load(std::memory_order_acquire) == 0)
+		{
+			return false;
+		}
+		if (header->layout_sequence.load(std::memory_order_acquire) != layout_sequence_ && !ReadLayout())
+		{
+			continue;
+		}
+		if (infos_.empty())
+		{
+			// the current tree does not fit in the region
+			return false;
+		}
+
+		unsigned int index = header->latest.load(std::memory_order_acquire) % kBuffersNumber;
+		const char* buffer = region_ + BufferOffset(header->nodes_capacity, header->strings_capacity, index);
+		const SnapshotBufferHeader* buffer_header = reinterpret_cast<const SnapshotBufferHeader*>(buffer);
+		unsigned int sequence = buffer_header->sequence.load(std::memory_order_acquire);
+		if ((sequence & 1) != 0 || buffer_header->layout_sequence != layout_sequence_)
+		{
+			continue;
+		}
+
+		states.resize(infos_.size());
+		std::memcpy(states.data(), buffer + sizeof(SnapshotBufferHeader), states.size() * sizeof(SnapshotNodeState));
+		unsigned long long frame = buffer_header->frame;
+		long long timestamp_ns = buffer_header->timestamp_ns;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (buffer_header->sequence.load(std::memory_order_relaxed) != sequence)
+		{
+			continue;
+		}
+
+		snapshot.frame = frame;
+		snapshot.timestamp_ns = timestamp_ns;
+		snapshot.nodes.resize(infos_.size());
+		for (unsigned int i = 0; i < infos_.size(); i++)
+		{
+			SnapshotNode& node = snapshot.nodes[i];
+			const SnapshotNodeInfo& info = infos_[i];
+			node.name = std::string_view(strings_.c_str() + std::min<size_t>(info.name, strings_.size()));
+			node.parent = info.parent;
+			node.depth = info.depth;
+			node.node_type = (NodeType)info.node_type;
+			node.draw_type = (DrawNodeType)info.draw_type;
+			node.status = (ReturnStatus)states[i].status;
+			node.color_status = (ReturnStatus)states[i].color_status;
+			node.x_pose = states[i].x_pose;
+			node.x_shift = states[i].x_shift;
+		}
+		return true;
+	}
+	return false;
+}
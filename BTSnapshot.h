@@ -0,0 +1,143 @@
+#pragma once
+#include"BTs.h"
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace BT
+{
+	// Shared memory region of the tree snapshots ("BTSS" version 1, native byte order):
+	//   SnapshotHeader
+	//   SnapshotNodeInfo infos[nodes_capacity]     the layout: the nodes in pre-order
+	//   char strings[strings_capacity]             null-terminated names
+	//   3 x (SnapshotBufferHeader, SnapshotNodeState states[nodes_capacity])
+	// The publisher writes each frame into the buffer after the latest one, then makes it
+	// the latest: a reader copies the latest buffer and checks that its sequence has not
+	// changed meanwhile (odd while it is written). The layout is rewritten only when the
+	// root changes, under its own sequence.
+	struct SnapshotHeader
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int nodes_capacity;
+		unsigned int strings_capacity;
+		std::atomic<unsigned int> layout_sequence;
+		unsigned int nodes_number;
+		unsigned int strings_size;
+		std::atomic<unsigned int> latest;
+		std::atomic<unsigned long long> frames;
+	};
+
+	struct SnapshotNodeInfo
+	{
+		int parent;
+		unsigned int name;
+		unsigned short depth;
+		unsigned char node_type;
+		unsigned char draw_type;
+	};
+
+	struct SnapshotBufferHeader
+	{
+		std::atomic<unsigned int> sequence;
+		unsigned int layout_sequence;
+		unsigned long long frame;
+		long long timestamp_ns;
+	};
+
+	struct SnapshotNodeState
+	{
+		unsigned char status;
+		unsigned char color_status;
+		float x_pose;
+		float x_shift;
+	};
+
+
+	// Publishes the state of a tree after each tick into a named POSIX shared memory region
+	// (shm_open), for viewers and monitors in other processes. Publish() reads each node
+	// once, with lock-free loads, and never waits for the readers.
+	// The region is sized for nodes_capacity nodes: a bigger tree is not published, and the
+	// readers get no frame while it is the published root.
+	// The layout (the nodes and their names) is read again only when the root changes: after
+	// adding or removing nodes in the tree, call InvalidateLayout() before the next Publish().
+	class TreeSnapshotPublisher
+	{
+	private:
+		std::string name_;
+		char* region_;
+		size_t region_size_;
+		TreeNode* root_;
+		std::vector<TreeNode*> nodes_;
+		bool is_publishable_;
+		std::atomic<bool> is_layout_valid_;
+
+		void Relayout(TreeNode* root);
+
+	public:
+		// Creates (or replaces) the region: throws std::runtime_error if it cannot be created.
+		// The name is a shm_open name, e.g. "/bt_snapshot".
+		TreeSnapshotPublisher(const std::string& name, unsigned int nodes_capacity = 4096, unsigned int strings_capacity = 1 << 16);
+
+		// Unmaps and unlinks the region; the readers keep their mapping
+		~TreeSnapshotPublisher();
+
+		// Publishes a frame of the tree; the layout is rewritten if the root has changed
+		// since the last frame. To be called from one thread, between two ticks.
+		void Publish(TreeNode* root);
+
+		// The next Publish() reads the layout again
+		void InvalidateLayout();
+
+		unsigned long long GetFramesNumber();
+	};
+
+
+	// A node of a frame read by a TreeSnapshotReader. The name stays valid until the
+	// reader sees another layout.
+	struct SnapshotNode
+	{
+		std::string_view name;
+		int parent;
+		unsigned int depth;
+		NodeType node_type;
+		DrawNodeType draw_type;
+		ReturnStatus status;
+		ReturnStatus color_status;
+		float x_pose;
+		float x_shift;
+	};
+
+	struct TreeSnapshot
+	{
+		unsigned long long frame;
+		long long timestamp_ns;
+		std::vector<SnapshotNode> nodes;
+	};
+
+	// Reads the frames of a TreeSnapshotPublisher, possibly from another process,
+	// at its own rate: it never blocks the publisher, and sees only the latest frame.
+	class TreeSnapshotReader
+	{
+	private:
+		const char* region_;
+		size_t region_size_;
+		unsigned int layout_sequence_;
+		std::vector<SnapshotNodeInfo> infos_;
+		std::string strings_;
+
+		bool ReadLayout();
+
+	public:
+		// Maps the region read-only: throws std::runtime_error if it does not exist
+		TreeSnapshotReader(const std::string& name);
+		~TreeSnapshotReader();
+
+		// Copies the latest frame; returns false if none is available (nothing published
+		// yet, a tree too big for the region, or the publisher kept overwriting the frame
+		// during the copy)
+		bool Read(TreeSnapshot& snapshot);
+	};
+};
@@ -0,0 +1,215 @@
+#pragma once
+#include"BTs.h"
+
+// The static trees need C++17 (fold expressions)
+#if defined(__cpp_fold_expressions)
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+// Trees whose shape is known at compile time, e.g.
+//     typedef BT::Static::Sequence<IsReady, BT::Static::Selector<Grasp, Push>> MyTree;
+// A leaf is any default constructible type with "BT::ReturnStatus Tick()" and, if it can
+// be RUNNING, "void Halt()". The nodes are stored by value in their father, so a tree is
+// one object without allocation, and the ticks are plain calls the compiler can inline.
+// The Sequence/Selector semantics are the ones of SequenceNode/SelectorNode, except that
+// every leaf is ticked on the calling thread (as a condition) and the ticks are not traced.
+namespace BT
+{
+	namespace Static
+	{
+		namespace Detail
+		{
+			template <class T, class = void>
+			struct HasHalt : std::false_type {};
+			template <class T>
+			struct HasHalt<T, std::void_t<decltype(std::declval<T&>().Halt())>> : std::true_type {};
+
+			// Sequence and selector differ only in the status that lets the tick go on
+			template <ReturnStatus GoOn, class... Children>
+			class Composite
+			{
+				static_assert(sizeof...(Children) > 0, "a static control node needs children");
+
+			private:
+				std::tuple<Children...> children_;
+				ReturnStatus children_states_[sizeof...(Children)];
+				ReturnStatus status_;
+
+				template <std::size_t I>
+				bool TickChild(ReturnStatus& status, std::size_t& stopped)
+				{
+					status = std::get<I>(children_).Tick();
+					// the child goes in idle once it has returned its result
+					children_states_[I] = (status == BT::RUNNING) ? BT::RUNNING : BT::IDLE;
+					stopped = I;
+					return status == GoOn;
+				}
+
+				template <std::size_t I>
+				void HaltChild()
+				{
+					if (children_states_[I] == BT::RUNNING)
+					{
+						if constexpr (HasHalt<typename std::tuple_element<I, std::tuple<Children...>>::type>::value)
+						{
+							std::get<I>(children_).Halt();
+						}
+						children_states_[I] = BT::HALTED;
+					}
+				}
+
+				template <std::size_t... Is>
+				ReturnStatus TickChildren(std::index_sequence<Is...>)
+				{
+					ReturnStatus status = GoOn;
+					std::size_t stopped = 0;
+					if ((TickChild<Is>(status, stopped) && ...))
+					{
+						status_ = GoOn;
+						return GoOn;
+					}
+
+					// halts the children after the one that has stopped the tick
+					((Is > stopped ? HaltChild<Is>() : void()), ...);
+					status_ = status;
+					return status;
+				}
+
+				template <std::size_t... Is>
+				void HaltChildren(std::index_sequence<Is...>)
+				{
+					(HaltChild<Is>(), ...);
+				}
+
+			public:
+				Composite() : status_(BT::IDLE)
+				{
+					for (std::size_t i = 0; i < sizeof...(Children); i++)
+					{
+						children_states_[i] = BT::IDLE;
+					}
+				}
+
+				ReturnStatus Tick()
+				{
+					return TickChildren(std::index_sequence_for<Children...>());
+				}
+
+				void Halt()
+				{
+					HaltChildren(std::index_sequence_for<Children...>());
+					status_ = BT::HALTED;
+				}
+
+				ReturnStatus get_status() const { return status_; }
+
+				// The child I, e.g. to configure a leaf
+				template <std::size_t I>
+				typename std::tuple_element<I, std::tuple<Children...>>::type& get()
+				{
+					return std::get<I>(children_);
+				}
+			};
+		}
+
+
+		template <class... Children>
+		class Sequence : public Detail::Composite<BT::SUCCESS, Children...>
+		{
+		public:
+			static const int kDrawType = BT::SEQUENCE;
+		};
+
+		template <class... Children>
+		class Selector : public Detail::Composite<BT::FAILURE, Children...>
+		{
+		public:
+			static const int kDrawType = BT::SELECTOR;
+		};
+
+
+		// Leaf that calls a function, e.g. Function<&IsBatteryLow>
+		template <ReturnStatus (*F)()>
+		class Function
+		{
+		public:
+			ReturnStatus Tick() { return F(); }
+		};
+
+
+		// Leaf that ticks a runtime subtree (or node) exactly as a runtime father does:
+		// an action runs on its executor, a condition answers from its cache.
+		// The node is given with set_node() before the first tick, and it is not owned.
+		class Subtree
+		{
+		private:
+			// Never ticked: it routes the ticks and the halts to its only child
+			SequenceNode father_;
+
+		public:
+			Subtree() : father_("static subtree") {}
+
+			// Throws std::logic_error if the subtree already has a node
+			void set_node(TreeNode* node)
+			{
+				if (father_.GetChildrenNumber() != 0)
+				{
+					throw std::logic_error("a static subtree has only one node");
+				}
+				father_.AddChild(node);
+			}
+			TreeNode* get_node()
+			{
+				return father_.GetChildrenNumber() != 0 ? father_.GetChildren()[0] : nullptr;
+			}
+
+			ReturnStatus Tick()
+			{
+				ReturnStatus status = father_.TickChild(0);
+				if (status == BT::SUCCESS || status == BT::FAILURE)
+				{
+					father_.GetChildren()[0]->set_status(BT::IDLE);
+				}
+				return status;
+			}
+			void Halt()
+			{
+				father_.HaltChildren(0);
+			}
+		};
+	}
+
+
+	// Node of a runtime tree that ticks a static tree. Like a coroutine action, it is ticked
+	// directly by its father, it can be RUNNING and it receives the halts; it has its own
+	// type, so that the tracing, the replay and the dumps tell the two apart.
+	template <class Tree>
+	class StaticTreeNode : public LeafNode
+	{
+	private:
+		Tree tree_;
+
+	public:
+		StaticTreeNode(std::string name) : LeafNode(name)
+		{
+			type_ = BT::STATIC_TREE_NODE;
+		}
+		~StaticTreeNode() {}
+
+		BT::ReturnStatus Tick() { return tree_.Tick(); }
+		void Halt()
+		{
+			tree_.Halt();
+			set_status(BT::HALTED);
+		}
+		int DrawType() { return Tree::kDrawType; }
+
+		Tree& get_tree() { return tree_; }
+	};
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include"BTThreading.h"
+#include"BTLog.h"
+#include <cstring>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace
+{
+#if defined(__linux__)
+	void RecordFailure(BT::ThreadPolicyResult& result, int error, const std::string& what)
+	{
+		if (result.error == 0)
+		{
+			result.error = error;
+			result.message = what + ": " + std::strerror(error);
+		}
+		BT_LOG_WARNING("threading", "%s: %s", what.c_str(), std::strerror(error));
+	}
+
+	BT::ThreadPolicyResult Apply(pthread_t thread, const BT::ThreadPolicy& policy)
+	{
+		BT::ThreadPolicyResult result = BT::ThreadPolicyResult();
+		result.is_affinity_applied = true;
+		result.is_priority_applied = true;
+		result.is_name_applied = true;
+
+		if (!policy.cpus.empty())
+		{
+			cpu_set_t cpu_set;
+			CPU_ZERO(&cpu_set);
+			for (unsigned int i = 0; i < policy.cpus.size(); i++)
+			{
+				if (policy.cpus[i] >= 0 && policy.cpus[i] < CPU_SETSIZE)
+				{
+					CPU_SET(policy.cpus[i], &cpu_set);
+				}
+			}
+			int error = pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set);
+			if (error != 0)
+			{
+				result.is_affinity_applied = false;
+				RecordFailure(result, error, "cannot set the CPU affinity of '" + policy.name + "'");
+			}
+		}
+
+		if (policy.priority > 0)
+		{
+			sched_param parameters = sched_param();
+			parameters.sched_priority = policy.priority;
+			int error = pthread_setschedparam(thread, SCHED_FIFO, &parameters);
+			if (error != 0)
+			{
+				result.is_priority_applied = false;
+				RecordFailure(result, error, "cannot set SCHED_FIFO priority " + std::to_string(policy.priority) + " of '" + policy.name + "'");
+			}
+		}
+
+		if (!policy.name.empty())
+		{
+			std::string name = policy.name.substr(0, 15);
+			int error = pthread_setname_np(thread, name.c_str());
+			if (error != 0)
+			{
+				result.is_name_applied = false;
+				RecordFailure(result, error, "cannot name the thread '" + name + "'");
+			}
+		}
+		return result;
+	}
+#else
+	BT::ThreadPolicyResult Unsupported(const BT::ThreadPolicy& policy)
+	{
+		BT::ThreadPolicyResult result = BT::ThreadPolicyResult();
+		result.is_affinity_applied = policy.cpus.empty();
+		result.is_priority_applied = policy.priority == 0;
+		result.is_name_applied = policy.name.empty();
+		if (!result.is_applied())
+		{
+			result.message = "thread policies are only supported on Linux";
+			BT_LOG_WARNING("threading", "%s", result.message.c_str());
+		}
+		return result;
+	}
+#endif
+}
+
+
+BT::ThreadPolicyResult BT::ApplyThreadPolicy(const ThreadPolicy& policy)
+{
+#if defined(__linux__)
+	return Apply(pthread_self(), policy);
+#else
+	return Unsupported(policy);
+#endif
+}
+BT::ThreadPolicyResult BT::ApplyThreadPolicy(std::thread& thread, const ThreadPolicy& policy)
+{
+#if defined(__linux__)
+	return Apply(thread.native_handle(), policy);
+#else
+	(void)thread;
+	return Unsupported(policy);
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace BT
+{
+	// Placement and priority of a thread (Linux only):
+	// - "cpus" are the cores the thread may run on (empty: anywhere);
+	// - "priority" 1-99 runs the thread SCHED_FIFO at that priority, 0 leaves SCHED_OTHER;
+	//   it needs CAP_SYS_NICE or an RLIMIT_RTPRIO large enough;
+	// - "name" is shown by top and perf (empty: unchanged); the kernel keeps 15 characters.
+	struct ThreadPolicy
+	{
+		std::vector<int> cpus;
+		int priority;
+		std::string name;
+
+		ThreadPolicy() : priority(0) {}
+	};
+
+	// What could be applied; "message" describes the first failure
+	struct ThreadPolicyResult
+	{
+		bool is_affinity_applied;
+		bool is_priority_applied;
+		bool is_name_applied;
+		int error;
+		std::string message;
+
+		bool is_applied() const { return is_affinity_applied && is_priority_applied && is_name_applied; }
+	};
+
+	// Applies the policy to the calling thread, or to another thread. The settings are
+	// independent: one that fails (e.g. SCHED_FIFO without the permission) does not
+	// prevent the others. The failures are also logged as warnings.
+	ThreadPolicyResult ApplyThreadPolicy(const ThreadPolicy& policy);
+	ThreadPolicyResult ApplyThreadPolicy(std::thread& thread, const ThreadPolicy& policy);
+};
@@ -0,0 +1,165 @@
+#include"BTTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace
+{
+	// Single-writer ring of events, owned by one thread
+	struct TraceBuffer
+	{
+		unsigned int thread_index;
+		std::atomic<unsigned long long> head;
+		std::unique_ptr<BT::TraceEvent[]> events;
+
+		TraceBuffer(unsigned int index) : thread_index(index), head(0), events(new BT::TraceEvent[BT::Tracer::kBufferCapacity]) {}
+	};
+
+	// The buffers outlive their threads, so that they can still be exported
+	std::mutex registry_mutex;
+	std::vector<std::unique_ptr<TraceBuffer>> registry;
+
+	thread_local TraceBuffer* thread_buffer = nullptr;
+
+	const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+	TraceBuffer* GetThreadBuffer()
+	{
+		if (thread_buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> LockGuard(registry_mutex);
+			registry.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(registry.size())));
+			thread_buffer = registry.back().get();
+		}
+		return thread_buffer;
+	}
+
+	const char* StatusName(unsigned char status)
+	{
+		switch (status)
+		{
+		case BT::RUNNING: return "RUNNING";
+		case BT::SUCCESS: return "SUCCESS";
+		case BT::FAILURE: return "FAILURE";
+		case BT::IDLE: return "IDLE";
+		case BT::HALTED: return "HALTED";
+		default: return "EXIT";
+		}
+	}
+
+	void WriteJsonString(FILE* file, std::string_view text)
+	{
+		std::fputc('"', file);
+		for (unsigned int i = 0; i < text.size(); i++)
+		{
+			unsigned char c = text[i];
+			if (c == '"' || c == '\\')
+			{
+				std::fputc('\\', file);
+				std::fputc(c, file);
+			}
+			else if (c < 0x20)
+			{
+				std::fprintf(file, "\\u%04x", c);
+			}
+			else
+			{
+				std::fputc(c, file);
+			}
+		}
+		std::fputc('"', file);
+	}
+}
+
+
+std::atomic<bool> BT::Tracer::is_enabled_(false);
+
+void BT::Tracer::Enable()
+{
+	is_enabled_.store(true);
+}
+void BT::Tracer::Disable()
+{
+	is_enabled_.store(false);
+}
+void BT::Tracer::Record(TraceEventType type, TreeNode* node, ReturnStatus status)
+{
+	TraceBuffer* buffer = GetThreadBuffer();
+	unsigned long long head = buffer->head.load(std::memory_order_relaxed);
+
+	TraceEvent& event = buffer->events[head % kBufferCapacity];
+	event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count();
+	event.node = node;
+	event.type = (unsigned char)type;
+	event.status = (unsigned char)status;
+
+	// publishes the event to the exporter
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+void BT::Tracer::Clear()
+{
+	std::lock_guard<std::mutex> LockGuard(registry_mutex);
+	for (unsigned int i = 0; i < registry.size(); i++)
+	{
+		registry[i]->head.store(0);
+	}
+}
+bool BT::Tracer::WriteChromeTrace(const std::string& file_path)
+{
+	FILE* file = std::fopen(file_path.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	std::fprintf(file, "{\"traceEvents\":[\n");
+	bool is_first = true;
+
+	std::lock_guard<std::mutex> LockGuard(registry_mutex);
+	for (unsigned int b = 0; b < registry.size(); b++)
+	{
+		TraceBuffer& buffer = *registry[b];
+		unsigned long long head = buffer.head.load(std::memory_order_acquire);
+		unsigned long long first = (head > kBufferCapacity) ? head - kBufferCapacity : 0;
+
+		for (unsigned long long i = first; i < head; i++)
+		{
+			const TraceEvent& event = buffer.events[i % kBufferCapacity];
+			const char* phase;
+			switch (event.type)
+			{
+			case BT::TRACE_TICK_BEGIN: phase = "B"; break;
+			case BT::TRACE_TICK_END: phase = "E"; break;
+			default: phase = "i"; break;
+			}
+
+			std::fprintf(file, "%s{\"name\":", is_first ? "" : ",\n");
+			is_first = false;
+			if (event.type == BT::TRACE_HALT)
+			{
+				WriteJsonString(file, "halt " + std::string(event.node->get_name()));
+			}
+			else
+			{
+				WriteJsonString(file, event.node->get_name());
+			}
+			std::fprintf(file, ",\"cat\":\"bt\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+				phase, event.timestamp_ns / 1000.0, buffer.thread_index);
+			if (event.type == BT::TRACE_STATUS || event.type == BT::TRACE_HALT)
+			{
+				std::fprintf(file, ",\"s\":\"t\"");
+			}
+			if (event.type != BT::TRACE_TICK_BEGIN)
+			{
+				std::fprintf(file, ",\"args\":{\"status\":\"%s\"}", StatusName(event.status));
+			}
+			std::fprintf(file, "}");
+		}
+	}
+	std::fprintf(file, "\n]}\n");
+
+	return std::fclose(file) == 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include"BTs.h"
+#include <atomic>
+#include <string>
+
+// Set BT_ENABLE_TRACING to 0 to compile the trace points out
+#ifndef BT_ENABLE_TRACING
+#define BT_ENABLE_TRACING 1
+#endif
+
+
+namespace BT
+{
+	// Enumerates the events recorded by the tracer:
+	// - "TRACE_TICK_BEGIN"/"TRACE_TICK_END" delimit the tick of a node;
+	// - "TRACE_STATUS" is a status transition;
+	// - "TRACE_HALT" is a halt sent to a node.
+	enum TraceEventType { TRACE_TICK_BEGIN, TRACE_TICK_END, TRACE_STATUS, TRACE_HALT };
+
+	struct TraceEvent
+	{
+		unsigned long long timestamp_ns;
+		TreeNode* node;
+		unsigned char type;
+		unsigned char status;
+	};
+
+	// Records per-node events into per-thread ring buffers and exports them as
+	// Chrome trace JSON (readable by chrome://tracing and Perfetto).
+	// Each thread writes only to its own buffer, without locks; when a buffer is
+	// full the oldest events are overwritten.
+	// The node names are read at export time, so the nodes must still exist then.
+	class Tracer
+	{
+	private:
+		static std::atomic<bool> is_enabled_;
+
+	public:
+		// Events per thread buffer
+		static const unsigned int kBufferCapacity = 1 << 16;
+
+		static void Enable();
+		static void Disable();
+		static bool is_enabled()
+		{
+			return is_enabled_.load(std::memory_order_relaxed);
+		}
+
+		// Appends an event to the buffer of the calling thread
+		static void Record(TraceEventType type, TreeNode* node, ReturnStatus status);
+
+		// Drops all the recorded events
+		static void Clear();
+
+		// Writes the recorded events; call it after Disable() to get an exact trace.
+		// Returns false if the file cannot be written.
+		static bool WriteChromeTrace(const std::string& file_path);
+	};
+};
+
+
+#if BT_ENABLE_TRACING
+#define BT_TRACE(type, node, status) do { if (BT::Tracer::is_enabled()) { BT::Tracer::Record(type, node, status); } } while (0)
+#else
+#define BT_TRACE(type, node, status) do { } while (0)
+#endif
+
+#define BT_TRACE_TICK_BEGIN(node) BT_TRACE(BT::TRACE_TICK_BEGIN, node, BT::IDLE)
+#define BT_TRACE_TICK_END(node, status) BT_TRACE(BT::TRACE_TICK_END, node, status)
+#define BT_TRACE_STATUS(node, status) BT_TRACE(BT::TRACE_STATUS, node, status)
+#define BT_TRACE_HALT(node) BT_TRACE(BT::TRACE_HALT, node, BT::HALTED)
@@ -1,96 +1,162 @@
 #pragma once
 #include"BTs.h"
+#include"BTExecutor.h"
+#include"BTScheduler.h"
+#include"BTTrace.h"
+#include"BTLog.h"
+#include"BTArena.h"
+#include"BTBlackboard.h"
+#include"BTReplay.h"
+#include"BTClock.h"
 
 
-void Execute(BT::ControlNode* root, int TickPeriod_milliseconds)
+void Execute(BT::ControlNode* root, int TickPeriod_milliseconds, const BT::ThreadPolicy* tick_policy)
 {
-	std::cout << "Start ticking!" << std::endl;
+	BT_LOG_INFO("Execute", "Start ticking!");
 
-	while (true)
+	// Ticks on absolute deadlines, until the process ends
+	BT::TickScheduler scheduler(root, std::chrono::milliseconds(TickPeriod_milliseconds));
+	if (tick_policy != nullptr)
 	{
-		std::cout << "Ticking the root node !" << std::endl;
-
-		root->Tick();
-
-		std::this_thread::sleep_for(std::chrono::milliseconds(TickPeriod_milliseconds));
+		scheduler.set_thread_policy(*tick_policy);
 	}
+	scheduler.Run();
 }
 
 
-TickEngine::TickEngine(int initial_value)
-{
-	value_ = initial_value;
-}
-TickEngine::~TickEngine() {}
-void TickEngine::Wait()
+namespace
 {
-	// Lock acquire (need a unique lock for the condition variable usage)
-	std::unique_lock<std::mutex> UniqueLock(mutex_);
+	static_assert(std::atomic<unsigned long long>::is_always_lock_free, "the node state word must be lock-free");
 
-	// If the state is 0 then we have to wait for a signal
-	if (value_ == 0)
-		condition_variable_.wait(UniqueLock);
+	unsigned long long PackState(BT::ReturnStatus status, BT::ReturnStatus color_status, unsigned int version)
+	{
+		return (unsigned long long)status | ((unsigned long long)color_status << 8) | ((unsigned long long)version << 32);
+	}
+	BT::ReturnStatus StatusOf(unsigned long long state)
+	{
+		return (BT::ReturnStatus)(state & 0xFF);
+	}
+	BT::ReturnStatus ColorStatusOf(unsigned long long state)
+	{
+		return (BT::ReturnStatus)((state >> 8) & 0xFF);
+	}
+	unsigned int VersionOf(unsigned long long state)
+	{
+		return (unsigned int)(state >> 32);
+	}
 
-	// Once here we decrement the state
-	value_--;
-}
-void TickEngine::Tick()
-{
-	// Lock acquire
+	// Shared table of mutexes and condition variables for the rare blocking waits
+	// (halts, stops) and the hand-off of the action ticks: the nodes do not need one
+	// each. A slot is chosen by address.
+	struct WaitSlot
+	{
+		std::mutex mutex;
+		std::condition_variable condition_variable;
+	};
+	WaitSlot wait_slots[64];
 
-	std::lock_guard<std::mutex> LockGuard(mutex_);
+	WaitSlot& GetWaitSlot(const void* address)
+	{
+		return wait_slots[((unsigned long long)address >> 6) % 64];
+	}
+	void NotifyWaitSlot(const void* address)
+	{
+		// Taking the lock orders the notification after the waiter checked its predicate
+		WaitSlot& slot = GetWaitSlot(address);
+		{
+			std::lock_guard<std::mutex> LockGuard(slot.mutex);
+		}
+		slot.condition_variable.notify_all();
+	}
 
-	// State increment
-	value_++;
+	long long SteadyNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
 
-	// Notification
-	condition_variable_.notify_all();
+	// The action tick executed by the calling thread, for ActionNode::get_stop_token()
+	thread_local BT::ActionNode* executing_node = nullptr;
+	thread_local unsigned int executing_generation = 0;
 }
 
 
-BT::TreeNode::TreeNode(std::string name) : tick_engine(0)
+BT::TreeNode::TreeNode(std::string name) : state_(PackState(BT::IDLE, BT::IDLE, 0)), state_waiters_(0)
 {
 	// Initialization
-	name_ = name;
+	name_ = InternName(name);
 	is_state_updated_ = false;
 	set_status(BT::IDLE);
 }
 BT::TreeNode::~TreeNode() {}
 void BT::TreeNode::set_status(ReturnStatus new_status)
 {
-	if (new_status != BT::IDLE)
+	// state_ update: status, color status (unless the node goes idle) and version in one step.
+	// seq_cst so that the check of state_waiters_ below cannot be reordered before it.
+	unsigned long long old_state = state_.load(std::memory_order_relaxed);
+	unsigned long long new_state;
+	do
 	{
-		set_color_status(new_status);
+		ReturnStatus new_color_status = (new_status != BT::IDLE) ? new_status : ColorStatusOf(old_state);
+		new_state = PackState(new_status, new_color_status, VersionOf(old_state) + 1);
+	} while (!state_.compare_exchange_weak(old_state, new_state, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+	if (StatusOf(old_state) != new_status)
+	{
+		BT_TRACE_STATUS(this, new_status);
+		BT_LOG_DEBUG(name_.data(), "is setting its status to %d", new_status);
 	}
 
-	// Lock acquistion
-	std::unique_lock<std::mutex> UniqueLock(state_mutex_);
+	// Wakes up the father waiting for this node to receive its tick.
+	// The lock is taken only when somebody waits.
+	if (state_waiters_.load() != 0)
+	{
+		NotifyWaitSlot(this);
+	}
+}
+BT::NodeState BT::TreeNode::get_state()
+{
+	unsigned long long state = state_.load(std::memory_order_acquire);
 
-	// state_ update
-	status_ = new_status;
+	NodeState node_state;
+	node_state.status = StatusOf(state);
+	node_state.color_status = ColorStatusOf(state);
+	node_state.version = VersionOf(state);
+	return node_state;
 }
-BT::ReturnStatus BT::TreeNode::get_status()
+unsigned int BT::TreeNode::get_status_version()
 {
-	// Lock acquistion
-	//DEBUG_STDOUT(get_name() << " is setting its status to " << status_);
+	return VersionOf(state_.load(std::memory_order_acquire));
+}
+BT::ReturnStatus BT::TreeNode::WaitForStatusChange(unsigned int version)
+{
+	state_waiters_.fetch_add(1);
+	{
+		WaitSlot& slot = GetWaitSlot(this);
+		std::unique_lock<std::mutex> UniqueLock(slot.mutex);
 
-	std::lock_guard<std::mutex> LockGuard(state_mutex_);
+		slot.condition_variable.wait(UniqueLock, [this, version]() { return VersionOf(state_.load()) != version; });
+	}
+	state_waiters_.fetch_sub(1);
 
-	return status_;
+	return get_status();
+}
+BT::ReturnStatus BT::TreeNode::get_status()
+{
+	return StatusOf(state_.load(std::memory_order_acquire));
 }
 BT::ReturnStatus BT::TreeNode::get_color_status()
 {
-	// Lock acquistion
-	std::lock_guard<std::mutex> LockGuard(color_state_mutex_);
-
-	return color_status_;
+	return ColorStatusOf(state_.load(std::memory_order_acquire));
 }
 void BT::TreeNode::set_color_status(ReturnStatus new_color_status)
 {
-	// Lock acquistion
-	std::lock_guard<std::mutex> LockGuard(color_state_mutex_);
-	// state_ update
-	color_status_ = new_color_status;
+	// Only the color changes: the version counts the set_status() calls
+	unsigned long long old_state = state_.load(std::memory_order_relaxed);
+	unsigned long long new_state;
+	do
+	{
+		new_state = PackState(StatusOf(old_state), new_color_status, VersionOf(old_state));
+	} while (!state_.compare_exchange_weak(old_state, new_state, std::memory_order_release, std::memory_order_relaxed));
 }
 float BT::TreeNode::get_x_pose()
 {
@@ -108,11 +174,11 @@ void BT::TreeNode::set_x_shift(float x_shift)
 {
 	x_shift_ = x_shift;
 }
-void BT::TreeNode::set_name(std::string new_name)
+void BT::TreeNode::set_name(std::string_view new_name)
 {
-	name_ = new_name;
+	name_ = InternName(new_name);
 }
-std::string BT::TreeNode::get_name()
+std::string_view BT::TreeNode::get_name()
 {
 	return name_;
 }
@@ -149,17 +215,22 @@ void BT::ControlNode::AddChild(TreeNode* child)
 	children_nodes_.push_back(child);
 	children_states_.push_back(BT::IDLE);
 }
+void BT::ControlNode::ReserveChildren(unsigned int children_number)
+{
+	children_nodes_.reserve(children_number);
+	children_states_.reserve(children_number);
+}
 unsigned int BT::ControlNode::GetChildrenNumber()
 {
 	return children_nodes_.size();
 }
 void BT::ControlNode::Halt()
 {
-	//DEBUG_STDOUT("HALTING: " << get_name());
+	BT_LOG_DEBUG(get_name().data(), "HALTING");
 	HaltChildren(0);
 	set_status(BT::HALTED);
 }
-std::vector<BT::TreeNode*> BT::ControlNode::GetChildren()
+const std::vector<BT::TreeNode*>& BT::ControlNode::GetChildren()
 {
 	return children_nodes_;
 }
@@ -173,6 +244,8 @@ void BT::ControlNode::ResetColorState()
 }
 void BT::ControlNode::HaltChildren(int i)
 {
+	TickHook* hook = TickHook::get_current();
+	bool has_halted_actions = false;
 	for (unsigned int j = i; j < children_nodes_.size(); j++)
 	{
 		if (children_nodes_[j]->get_type() == BT::CONDITION_NODE)
@@ -183,16 +256,94 @@ void BT::ControlNode::HaltChildren(int i)
 		{
 			if (children_nodes_[j]->get_status() == BT::RUNNING)
 			{
-				//DEBUG_STDOUT("SENDING HALT TO CHILD " << children_nodes_[j]->get_name());
-				children_nodes_[j]->Halt();
+				BT_LOG_DEBUG(get_name().data(), "SENDING HALT TO CHILD %s", children_nodes_[j]->get_name().data());
+				BT_TRACE_HALT(children_nodes_[j]);
+				if (hook != nullptr && hook->BeforeHalt(children_nodes_[j]))
+				{
+					// replayed: the leaf was never really running
+					children_nodes_[j]->set_status(BT::HALTED);
+				}
+				else if (children_nodes_[j]->get_type() == BT::ACTION_NODE)
+				{
+					// all the actions are asked to stop first, so they stop at the same time
+					static_cast<ActionNode*>(children_nodes_[j])->RequestHalt();
+					has_halted_actions = true;
+				}
+				else
+				{
+					children_nodes_[j]->Halt();
+				}
 			}
 			else
 			{
-				//DEBUG_STDOUT("NO NEED TO HALT " << children_nodes_[j]->get_name()
-				//	<< "STATUS" << children_nodes_[j]->get_status());
+				BT_LOG_DEBUG(get_name().data(), "NO NEED TO HALT %s, STATUS %d", children_nodes_[j]->get_name().data(), children_nodes_[j]->get_status());
 			}
 		}
 	}
+
+	// then waits for them, each up to its halt timeout
+	for (unsigned int j = i; has_halted_actions && j < children_nodes_.size(); j++)
+	{
+		if (children_nodes_[j]->get_type() == BT::ACTION_NODE)
+		{
+			static_cast<ActionNode*>(children_nodes_[j])->WaitForHalt();
+		}
+	}
+}
+BT::ReturnStatus BT::ControlNode::TickChild(unsigned int i)
+{
+	/*      Ticking an action is different from ticking a condition. An action executed some portion of code in another thread.
+			We want this thread detached so we can cancel its execution (when the action no longer receive ticks).
+			Hence we cannot just call the method Tick() from the action as doing so will block the execution of the tree.
+			For this reason if a child of this node is an action, then we send the tick through the executor. Otherwise we call the method Tick() and wait for the response.
+	*/
+	TreeNode* child = children_nodes_[i];
+	ReturnStatus child_status;
+	BT_TRACE_TICK_BEGIN(child);
+
+	TickHook* hook = TickHook::get_current();
+	bool is_leaf = (child->get_type() != BT::CONTROL_NODE);
+	if (hook != nullptr && is_leaf && hook->BeforeLeafTick(child, child_status))
+	{
+		// 0) The result of the leaf is given by the hook (replay)
+		child->set_status(child_status);
+	}
+	else if (child->get_type() == BT::ACTION_NODE)
+	{
+		// 1) If the child i is an action, read its state.
+		child_status = child->get_status();
+
+		if (child_status == BT::IDLE || child_status == BT::HALTED)
+		{
+			// 1.1) If the action status is not running, the father sends a tick to it
+			// and sleeps until the action notifies that the tick has arrived.
+			BT_LOG_DEBUG(get_name().data(), "NEEDS TO TICK %s", child->get_name().data());
+			unsigned int version = child->get_status_version();
+			static_cast<ActionNode*>(child)->SendTick();
+			child_status = child->WaitForStatusChange(version);
+		}
+	}
+	else
+	{
+		// 2) if it's not an action:
+		// Send the tick and wait for the response (a condition may answer from its cache);
+		if (child->get_type() == BT::CONDITION_NODE)
+		{
+			child_status = static_cast<ConditionNode*>(child)->Evaluate();
+		}
+		else
+		{
+			child_status = child->Tick();
+		}
+		child->set_status(child_status);
+	}
+
+	if (hook != nullptr && is_leaf)
+	{
+		hook->AfterLeafTick(child, child_status);
+	}
+	BT_TRACE_TICK_END(child, child_status);
+	return child_status;
 }
 int BT::ControlNode::Depth()
 {
@@ -214,7 +365,7 @@ BT::LeafNode::LeafNode(std::string name) : TreeNode(name) {}
 BT::LeafNode::~LeafNode() {}
 void BT::LeafNode::ResetColorState()
 {
-	color_status_ = BT::IDLE;
+	set_color_status(BT::IDLE);
 }
 int BT::LeafNode::Depth()
 {
@@ -222,40 +373,296 @@ int BT::LeafNode::Depth()
 }
 
 
-BT::ConditionNode::ConditionNode(std::string name) : LeafNode::LeafNode(name)
+BT::ConditionNode::ConditionNode(std::string name) : LeafNode::LeafNode(name),
+	is_cache_valid_(false), cached_status_(BT::IDLE), cache_hits_(0), cache_misses_(0)
 {
 	type_ = BT::CONDITION_NODE;
 }
 BT::ConditionNode::~ConditionNode() {}
 void BT::ConditionNode::Halt() {}
+BT::ReturnStatus BT::ConditionNode::Evaluate()
+{
+	if (dependencies_.empty())
+	{
+		return Tick();
+	}
+
+	// The versions are read before the tick: a change during the tick invalidates the result
+	bool is_changed = !is_cache_valid_;
+	for (unsigned int i = 0; i < dependencies_.size(); i++)
+	{
+		Dependency& dependency = dependencies_[i];
+		unsigned int version = (dependency.blackboard != nullptr)
+			? dependency.blackboard->get_published_version(dependency.index)
+			: dependency.counter->load(std::memory_order_acquire);
+		if (version != dependency.version)
+		{
+			dependency.version = version;
+			is_changed = true;
+		}
+	}
+	if (!is_changed)
+	{
+		cache_hits_.fetch_add(1, std::memory_order_relaxed);
+		return cached_status_;
+	}
+
+	cache_misses_.fetch_add(1, std::memory_order_relaxed);
+	cached_status_ = Tick();
+
+	// only a final result can be reused
+	is_cache_valid_ = (cached_status_ == BT::SUCCESS || cached_status_ == BT::FAILURE);
+	return cached_status_;
+}
+void BT::ConditionNode::AddBlackboardDependency(Blackboard* blackboard, unsigned int index)
+{
+	Dependency dependency = { blackboard, index, nullptr, 0 };
+	dependencies_.push_back(dependency);
+	is_cache_valid_ = false;
+}
+void BT::ConditionNode::DependsOn(const std::atomic<unsigned int>& counter)
+{
+	Dependency dependency = { nullptr, 0, &counter, 0 };
+	dependencies_.push_back(dependency);
+	is_cache_valid_ = false;
+}
+void BT::ConditionNode::InvalidateCache()
+{
+	is_cache_valid_ = false;
+}
+unsigned long long BT::ConditionNode::GetCacheHits()
+{
+	return cache_hits_.load(std::memory_order_relaxed);
+}
+unsigned long long BT::ConditionNode::GetCacheMisses()
+{
+	return cache_misses_.load(std::memory_order_relaxed);
+}
 int BT::ConditionNode::DrawType()
 {
 	return BT::CONDITION;
 }
 
 
-BT::ActionNode::ActionNode(std::string name) : LeafNode::LeafNode(name)
+BT::ActionNode::ActionNode(std::string name) : LeafNode::LeafNode(name),
+	tick_generation_(0), halted_generation_(0), finished_generation_(0), halt_request_ns_(0),
+	halts_requested_(0), halts_completed_(0), halts_ignored_(0), halt_latency_sum_ns_(0), halt_latency_max_ns_(0),
+	pending_ticks_(0), is_tick_in_flight_(false), deferred_generation_(0)
 {
 	type_ = BT::ACTION_NODE;
-	thread_ = std::thread(&ActionNode::WaitForTick, this);
+	executor_ = nullptr;
+	halt_timeout_ = std::chrono::milliseconds(100);
+}
+BT::ActionNode::~ActionNode()
+{
+	WaitForTicks();
 }
-BT::ActionNode::~ActionNode() {}
-void BT::ActionNode::WaitForTick()
+void BT::ActionNode::SendTick()
 {
+	unsigned int generation = tick_generation_.fetch_add(1) + 1;
 
-	while (true)
+	// The action is running as soon as its tick is queued: the father does not have to
+	// wait for a free worker, which could never come if all the workers run blocking actions
+	set_status(BT::RUNNING);
+
+	pending_ticks_.fetch_add(1);
+
+	// A simulated time waits for the tick from now on, even while it is queued
+	GetDefaultClock()->BeginActivity();
+
+	// A tick abandoned by WaitForHalt() may still be running: the father does not wait
+	// for it, the new tick is deferred and replaces a deferred one that never started
+	bool is_deferred;
+	unsigned int replaced_generation = 0;
+	{
+		WaitSlot& slot = GetWaitSlot(this);
+		std::lock_guard<std::mutex> LockGuard(slot.mutex);
+		is_deferred = is_tick_in_flight_;
+		if (is_deferred)
+		{
+			replaced_generation = deferred_generation_;
+			deferred_generation_ = generation;
+		}
+		is_tick_in_flight_ = true;
+	}
+	if (replaced_generation != 0)
+	{
+		GetDefaultClock()->EndActivity();
+		pending_ticks_.fetch_sub(1);
+	}
+	if (!is_deferred)
+	{
+		SubmitTick(generation);
+	}
+}
+void BT::ActionNode::SubmitTick(unsigned int generation)
+{
+	get_executor()->Submit([this, generation]()
 	{
-		// Waiting for the tick to come
-		//DEBUG_STDOUT(get_name() << " WAIT FOR TICK");
+		{
+			Clock::ActivityScope scope;
+			ExecuteTick(generation);
+		}
+		GetDefaultClock()->EndActivity();
+	});
+}
+void BT::ActionNode::ExecuteTick(unsigned int generation)
+{
+	BT_LOG_DEBUG(get_name().data(), "TICK RECEIVED");
+	ActionNode* previous_node = executing_node;
+	unsigned int previous_generation = executing_generation;
+	executing_node = this;
+	executing_generation = generation;
+
+	BT_TRACE_TICK_BEGIN(this);
+	BT::ReturnStatus status = Tick();
+	BT_TRACE_TICK_END(this, status);
 
-		tick_engine.Wait();
-		//DEBUG_STDOUT(get_name() << " TICK RECEIVED");
+	executing_node = previous_node;
+	executing_generation = previous_generation;
 
-		// Running state
-		set_status(BT::RUNNING);
-		BT::ReturnStatus status = Tick();
+	if (halted_generation_.load() >= generation)
+	{
+		// The tick has been halted: measures the time it took to stop
+		long long latency_ns = SteadyNanoseconds() - halt_request_ns_.load();
+		halts_completed_++;
+		halt_latency_sum_ns_ += latency_ns;
+		long long max_ns = halt_latency_max_ns_.load();
+		while (latency_ns > max_ns && !halt_latency_max_ns_.compare_exchange_weak(max_ns, latency_ns)) {}
+		if (halt_timeout_.count() > 0 && latency_ns > halt_timeout_.count() && tick_generation_.load() == generation)
+		{
+			// (the abandoned ticks are counted by WaitForHalt())
+			halts_ignored_++;
+		}
+		status = BT::HALTED;
+	}
+
+	// A late result of an abandoned tick is dropped
+	if (tick_generation_.load() == generation)
+	{
 		set_status(status);
 	}
+
+	// An abandoned tick may finish after a later one
+	unsigned int finished_generation = finished_generation_.load();
+	while (generation > finished_generation && !finished_generation_.compare_exchange_weak(finished_generation, generation)) {}
+
+	// Schedules the tick deferred while this one was running
+	unsigned int deferred_generation;
+	{
+		WaitSlot& slot = GetWaitSlot(this);
+		std::lock_guard<std::mutex> LockGuard(slot.mutex);
+		deferred_generation = deferred_generation_;
+		deferred_generation_ = 0;
+		is_tick_in_flight_ = (deferred_generation != 0);
+	}
+	if (deferred_generation != 0)
+	{
+		SubmitTick(deferred_generation);
+	}
+
+	// The node may be destroyed as soon as the count drops: only its address is used after
+	const void* address = this;
+	pending_ticks_.fetch_sub(1);
+	NotifyWaitSlot(address);
+}
+void BT::ActionNode::WaitForTicks()
+{
+	if (pending_ticks_.load() == 0)
+	{
+		return;
+	}
+	WaitSlot& slot = GetWaitSlot(this);
+	std::unique_lock<std::mutex> UniqueLock(slot.mutex);
+	slot.condition_variable.wait(UniqueLock, [this]() { return pending_ticks_.load() == 0; });
+}
+void BT::ActionNode::RequestHalt()
+{
+	halt_request_ns_.store(SteadyNanoseconds());
+	halts_requested_++;
+	halted_generation_.store(tick_generation_.load());
+	NotifyWaitSlot(this);
+
+	// user defined part of the halt
+	Halt();
+}
+bool BT::ActionNode::WaitForHalt()
+{
+	unsigned int halted_generation = halted_generation_.load();
+	if (finished_generation_.load() >= halted_generation)
+	{
+		return true;
+	}
+	if (halt_timeout_.count() > 0)
+	{
+		WaitSlot& slot = GetWaitSlot(this);
+		std::unique_lock<std::mutex> UniqueLock(slot.mutex);
+		std::function<bool()> is_finished = [this, halted_generation]() { return finished_generation_.load() >= halted_generation; };
+		if (halt_timeout_ == std::chrono::nanoseconds::max())
+		{
+			slot.condition_variable.wait(UniqueLock, is_finished);
+		}
+		else
+		{
+			slot.condition_variable.wait_for(UniqueLock, halt_timeout_, is_finished);
+		}
+	}
+	if (finished_generation_.load() >= halted_generation)
+	{
+		return true;
+	}
+
+	// The tick ignores the halt: it is abandoned and the node can be ticked again (the
+	// next tick is deferred until this one returns, see SendTick())
+	unsigned int expected = halted_generation;
+	if (tick_generation_.compare_exchange_strong(expected, halted_generation + 1))
+	{
+		halts_ignored_++;
+		set_status(BT::HALTED);
+	}
+	return false;
+}
+BT::StopToken BT::ActionNode::get_stop_token()
+{
+	if (executing_node == this)
+	{
+		return StopToken(this, executing_generation);
+	}
+	return StopToken(this, tick_generation_.load());
+}
+bool BT::ActionNode::is_halted()
+{
+	return get_stop_token().stop_requested();
+}
+void BT::ActionNode::set_halt_timeout(std::chrono::nanoseconds halt_timeout)
+{
+	halt_timeout_ = halt_timeout;
+}
+std::chrono::nanoseconds BT::ActionNode::get_halt_timeout()
+{
+	return halt_timeout_;
+}
+BT::HaltStatistics BT::ActionNode::GetHaltStatistics()
+{
+	HaltStatistics statistics;
+	statistics.requested = halts_requested_.load();
+	statistics.completed = halts_completed_.load();
+	statistics.ignored = halts_ignored_.load();
+	statistics.mean_latency_us = (statistics.completed > 0) ? halt_latency_sum_ns_.load() / 1000.0 / statistics.completed : 0.0;
+	statistics.max_latency_us = halt_latency_max_ns_.load() / 1000.0;
+	return statistics;
+}
+void BT::ActionNode::set_executor(Executor* executor)
+{
+	executor_ = executor;
+}
+BT::Executor* BT::ActionNode::get_executor()
+{
+	if (executor_ == nullptr)
+	{
+		return BT::GetDefaultExecutor();
+	}
+	return executor_;
 }
 int BT::ActionNode::DrawType()
 {
@@ -263,6 +670,23 @@ int BT::ActionNode::DrawType()
 }
 
 
+BT::StopToken::StopToken(ActionNode* node, unsigned int generation)
+{
+	node_ = node;
+	generation_ = generation;
+}
+bool BT::StopToken::stop_requested() const
+{
+	return generation_ != 0 && node_->halted_generation_.load() >= generation_;
+}
+bool BT::StopToken::wait_for(std::chrono::nanoseconds duration) const
+{
+	WaitSlot& slot = GetWaitSlot(node_);
+	std::unique_lock<std::mutex> UniqueLock(slot.mutex);
+	return GetDefaultClock()->WaitFor(UniqueLock, slot.condition_variable, duration, [this]() { return stop_requested(); });
+}
+
+
 BT::SequenceNode::SequenceNode(std::string name) : ControlNode::ControlNode(name) {}
 BT::SequenceNode::~SequenceNode() {}
 BT::ReturnStatus BT::SequenceNode::Tick()
@@ -274,38 +698,7 @@ BT::ReturnStatus BT::SequenceNode::Tick()
 
 	for (unsigned int i = 0; i < N_of_children_; i++)
 	{
-		/*      Ticking an action is different from ticking a condition. An action executed some portion of code in another thread.
-				We want this thread detached so we can cancel its execution (when the action no longer receive ticks).
-				Hence we cannot just call the method Tick() from the action as doing so will block the execution of the tree.
-				For this reason if a child of this node is an action, then we send the tick using the tick engine. Otherwise we call the method Tick() and wait for the response.
-		*/
-		if (children_nodes_[i]->get_type() == BT::ACTION_NODE)
-		{
-			// 1) If the child i is an action, read its state.
-			child_i_status_ = children_nodes_[i]->get_status();
-
-			if (child_i_status_ == BT::IDLE || child_i_status_ == BT::HALTED)
-			{
-				// 1.1) If the action status is not running, the sequence node sends a tick to it.
-				//DEBUG_STDOUT(get_name() << "NEEDS TO TICK " << children_nodes_[i]->get_name());
-				children_nodes_[i]->tick_engine.Tick();
-
-				// waits for the tick to arrive to the child
-				do
-				{
-					child_i_status_ = children_nodes_[i]->get_status();
-					std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				} while (child_i_status_ != BT::RUNNING && child_i_status_ != BT::SUCCESS
-					&& child_i_status_ != BT::FAILURE);
-			}
-		}
-		else
-		{
-			// 2) if it's not an action:
-			// Send the tick and wait for the response;
-			child_i_status_ = children_nodes_[i]->Tick();
-			children_nodes_[i]->set_status(child_i_status_);
-		}
+		child_i_status_ = TickChild(i);
 		// Ponderate on which status to send to the parent
 		if (child_i_status_ != BT::SUCCESS)
 		{
@@ -315,7 +708,7 @@ BT::ReturnStatus BT::SequenceNode::Tick()
 				children_nodes_[i]->set_status(BT::IDLE);  // the child goes in idle if it has returned failure.
 			}
 
-			//DEBUG_STDOUT(get_name() << " is HALTING children from " << (i + 1));
+			BT_LOG_DEBUG(get_name().data(), "is HALTING children from %u", i + 1);
 			HaltChildren(i + 1);
 			set_status(child_i_status_);
 			return child_i_status_;
@@ -355,39 +748,7 @@ BT::ReturnStatus BT::SelectorNode::Tick()
 
 		for (unsigned int i = 0; i < N_of_children_; i++)
 		{
-			/*      Ticking an action is different from ticking a condition. An action executed some portion of code in another thread.
-					We want this thread detached so we can cancel its execution (when the action no longer receive ticks).
-					Hence we cannot just call the method Tick() from the action as doing so will block the execution of the tree.
-					For this reason if a child of this node is an action, then we send the tick using the tick engine. Otherwise we call the method Tick() and wait for the response.
-			*/
-			if (children_nodes_[i]->get_type() == BT::ACTION_NODE)
-			{
-				// 1) If the child i is an action, read its state.
-				child_i_status_ = children_nodes_[i]->get_status();
-
-				if (child_i_status_ == BT::IDLE || child_i_status_ == BT::HALTED)
-				{
-					// 1.1) If the action status is not running, the sequence node sends a tick to it.
-					//DEBUG_STDOUT(get_name() << "NEEDS TO TICK " << children_nodes_[i]->get_name());
-					children_nodes_[i]->tick_engine.Tick();
-
-					// waits for the tick to arrive to the child
-					do
-					{
-						child_i_status_ = children_nodes_[i]->get_status();
-						std::this_thread::sleep_for(std::chrono::milliseconds(10));
-					} while (child_i_status_ != BT::RUNNING && child_i_status_ != BT::SUCCESS
-						&& child_i_status_ != BT::FAILURE);
-				}
-			}
-			else
-			{
-				// 2) if it's not an action:
-				// Send the tick and wait for the response;
-				child_i_status_ = children_nodes_[i]->Tick();
-				children_nodes_[i]->set_status(child_i_status_);
-
-			}
+			child_i_status_ = TickChild(i);
 			// Ponderate on which status to send to the parent
 			if (child_i_status_ != BT::FAILURE)
 			{
@@ -396,7 +757,7 @@ BT::ReturnStatus BT::SelectorNode::Tick()
 					children_nodes_[i]->set_status(BT::IDLE);  // the child goes in idle if it has returned success.
 				}
 				// If the  child status is not failure, halt the next children and return the status to your parent.
-				//DEBUG_STDOUT(get_name() << " is HALTING children from " << (i + 1));
+				BT_LOG_DEBUG(get_name().data(), "is HALTING children from %u", i + 1);
 				HaltChildren(i + 1);
 				set_status(child_i_status_);
 				return child_i_status_;
@@ -422,3 +783,229 @@ int BT::SelectorNode::DrawType()
 	// Lock acquistion
 	return BT::SELECTOR;
 }
+
+
+
+BT::ParallelNode::ParallelNode(std::string name, SuccessPolicy success_policy, FailurePolicy failure_policy) : ControlNode::ControlNode(name)
+{
+	success_threshold_ = (success_policy == BT::SUCCEED_ON_ONE) ? 1 : 0;
+	failure_threshold_ = (failure_policy == BT::FAIL_ON_ONE) ? 1 : 0;
+}
+BT::ParallelNode::ParallelNode(std::string name, unsigned int success_threshold, unsigned int failure_threshold) : ControlNode::ControlNode(name)
+{
+	success_threshold_ = success_threshold;
+	failure_threshold_ = failure_threshold;
+}
+BT::ParallelNode::~ParallelNode() {}
+BT::ReturnStatus BT::ParallelNode::Tick()
+{
+	// gets the number of children. The number could change if, at runtime, one edits the tree.
+	N_of_children_ = children_nodes_.size();
+	dispatched_versions_.resize(N_of_children_);
+
+	if (N_of_children_ == 0)
+	{
+		// All of no children have succeeded, while one of them never can
+		ReturnStatus status = (success_threshold_ == 0) ? BT::SUCCESS : BT::FAILURE;
+		set_status(status);
+		return status;
+	}
+
+	unsigned int success_needed = success_threshold_;
+	if (success_needed == 0 || success_needed > N_of_children_)
+	{
+		success_needed = N_of_children_;
+	}
+	unsigned int failure_needed = failure_threshold_;
+	if (failure_needed == 0 || failure_needed > N_of_children_)
+	{
+		failure_needed = N_of_children_;
+	}
+
+	// 1) Sends the tick to all the idle actions first, so that they all run at the same time
+	// (unless a replay gives their results)
+	TickHook* hook = TickHook::get_current();
+	bool is_dispatching = (hook == nullptr || !hook->is_replacing_leaves());
+	for (unsigned int i = 0; i < N_of_children_; i++)
+	{
+		dispatched_versions_[i] = 0;
+		if (children_states_[i] == BT::SUCCESS || children_states_[i] == BT::FAILURE)
+		{
+			continue;
+		}
+		if (is_dispatching && children_nodes_[i]->get_type() == BT::ACTION_NODE)
+		{
+			child_i_status_ = children_nodes_[i]->get_status();
+			if (child_i_status_ == BT::IDLE || child_i_status_ == BT::HALTED)
+			{
+				dispatched_versions_[i] = children_nodes_[i]->get_status_version() + 1;
+				static_cast<ActionNode*>(children_nodes_[i])->SendTick();
+			}
+		}
+	}
+
+	// 2) Ticks the other children and collects the states.
+	// The children that have already returned keep their result until the parallel node returns.
+	unsigned int successes = 0;
+	unsigned int failures = 0;
+	for (unsigned int i = 0; i < N_of_children_; i++)
+	{
+		if (children_states_[i] != BT::SUCCESS && children_states_[i] != BT::FAILURE)
+		{
+			if (children_nodes_[i]->get_type() == BT::ACTION_NODE)
+			{
+				if (hook != nullptr && hook->BeforeLeafTick(children_nodes_[i], child_i_status_))
+				{
+					children_nodes_[i]->set_status(child_i_status_);
+				}
+				else if (dispatched_versions_[i] != 0)
+				{
+					// waits for the tick to arrive to the child
+					child_i_status_ = children_nodes_[i]->WaitForStatusChange(dispatched_versions_[i] - 1);
+				}
+				else
+				{
+					child_i_status_ = children_nodes_[i]->get_status();
+				}
+				if (hook != nullptr)
+				{
+					hook->AfterLeafTick(children_nodes_[i], child_i_status_);
+				}
+			}
+			else
+			{
+				child_i_status_ = TickChild(i);
+			}
+
+			if (child_i_status_ == BT::SUCCESS || child_i_status_ == BT::FAILURE)
+			{
+				// the result is stored here, the child goes in idle
+				children_states_[i] = child_i_status_;
+				children_nodes_[i]->set_status(BT::IDLE);
+			}
+		}
+
+		if (children_states_[i] == BT::SUCCESS)
+		{
+			successes++;
+		}
+		else if (children_states_[i] == BT::FAILURE)
+		{
+			failures++;
+		}
+	}
+
+	// Ponderate on which status to send to the parent.
+	// Failure takes precedence, and the node fails as soon as success can no longer be reached.
+	if (failures >= failure_needed || N_of_children_ - failures < success_needed)
+	{
+		BT_LOG_DEBUG(get_name().data(), "FAILED, HALTING the running children");
+		HaltChildren(0);
+		ResetChildrenStates();
+		set_status(BT::FAILURE);
+		return BT::FAILURE;
+	}
+	if (successes >= success_needed)
+	{
+		BT_LOG_DEBUG(get_name().data(), "SUCCEEDED, HALTING the running children");
+		HaltChildren(0);
+		ResetChildrenStates();
+		set_status(BT::SUCCESS);
+		return BT::SUCCESS;
+	}
+
+	set_status(BT::RUNNING);
+	return BT::RUNNING;
+}
+void BT::ParallelNode::Halt()
+{
+	ResetChildrenStates();
+	ControlNode::Halt();
+}
+void BT::ParallelNode::ResetChildrenStates()
+{
+	for (unsigned int i = 0; i < children_states_.size(); i++)
+	{
+		children_states_[i] = BT::IDLE;
+	}
+}
+int BT::ParallelNode::DrawType()
+{
+	return BT::PARALLEL;
+}
+void BT::ParallelNode::set_success_threshold(unsigned int success_threshold)
+{
+	success_threshold_ = success_threshold;
+}
+unsigned int BT::ParallelNode::get_success_threshold()
+{
+	return success_threshold_;
+}
+void BT::ParallelNode::set_failure_threshold(unsigned int failure_threshold)
+{
+	failure_threshold_ = failure_threshold;
+}
+unsigned int BT::ParallelNode::get_failure_threshold()
+{
+	return failure_threshold_;
+}
+
+
+
+namespace
+{
+	void CollectNodes(BT::TreeNode* root, std::vector<BT::TreeNode*>& nodes)
+	{
+		std::vector<BT::TreeNode*> stack(1, root);
+		while (!stack.empty())
+		{
+			BT::TreeNode* node = stack.back();
+			stack.pop_back();
+			nodes.push_back(node);
+			if (node->get_type() == BT::CONTROL_NODE)
+			{
+				const std::vector<BT::TreeNode*>& children = static_cast<BT::ControlNode*>(node)->GetChildren();
+				stack.insert(stack.end(), children.begin(), children.end());
+			}
+		}
+	}
+}
+
+
+void BT::HaltTree(TreeNode* root)
+{
+	if (root->get_type() == BT::ACTION_NODE)
+	{
+		if (root->get_status() == BT::RUNNING)
+		{
+			static_cast<ActionNode*>(root)->RequestHalt();
+			static_cast<ActionNode*>(root)->WaitForHalt();
+		}
+	}
+	else if (root->get_type() == BT::CONTROL_NODE || root->get_status() == BT::RUNNING)
+	{
+		root->Halt();
+	}
+
+	// The halted ticks, and the ones abandoned before, must return before the nodes can go
+	std::vector<TreeNode*> nodes;
+	CollectNodes(root, nodes);
+	for (unsigned int i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i]->get_type() == BT::ACTION_NODE)
+		{
+			static_cast<ActionNode*>(nodes[i])->WaitForTicks();
+		}
+	}
+}
+void BT::DestroyTree(TreeNode* root)
+{
+	HaltTree(root);
+
+	std::vector<TreeNode*> nodes;
+	CollectNodes(root, nodes);
+	for (unsigned int i = 0; i < nodes.size(); i++)
+	{
+		delete nodes[i];
+	}
+}
@@ -1,32 +1,29 @@
 #pragma once
 #include<string>
+#include <string_view>
 #include<iostream>
 #include <thread>
 #include <chrono>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include<vector>
 
 
-class TickEngine
-{
-private:
-	int value_;
-	std::mutex mutex_;
-	std::condition_variable condition_variable_;
-public:
-	TickEngine(int initial_value);
-	~TickEngine();
-	void Wait();
-	void Tick();
-};
-
-
 namespace BT
 {
+	class Executor;
+	class Blackboard;
+	struct ThreadPolicy;
+	template <typename T> class BlackboardKey;
+
 	// Enumerates the possible types of a node, for drawinf we have do discriminate whoich control node it is:
 
-	enum NodeType { ACTION_NODE, CONDITION_NODE, CONTROL_NODE };
+	// A "COROUTINE_ACTION_NODE" is ticked directly by its father, like a condition,
+	// but it can be RUNNING and receive a halt, like an action.
+	// A "STATIC_TREE_NODE" is ticked and halted the same way, and runs a whole tree
+	// composed at compile time (see BTStatic.h).
+	enum NodeType { ACTION_NODE, CONDITION_NODE, CONTROL_NODE, COROUTINE_ACTION_NODE, STATIC_TREE_NODE };
 	enum DrawNodeType { PARALLEL, SELECTOR, SEQUENCE, SEQUENCESTAR, SELECTORSTAR, ACTION, CONDITION, DECORATOR };
 	// Enumerates the states every node can be in after execution during a particular
 	// time step:
@@ -57,38 +54,53 @@ namespace BT
 	// If "BT::FAIL_ON_ONE" and "BT::SUCCEED_ON_ONE" are both active and are both trigerred in the
 	// same time step, failure will take precedence.
 
+	// Halts received by an action since its creation:
+	// the latency goes from the halt request to the return of the halted Tick(),
+	// the ignored halts are the ones that took longer than the halt timeout.
+	struct HaltStatistics
+	{
+		unsigned long long requested;
+		unsigned long long completed;
+		unsigned long long ignored;
+		double mean_latency_us;
+		double max_latency_us;
+	};
+
+	// A consistent copy of the state of a node, read with a single atomic load
+	struct NodeState
+	{
+		ReturnStatus status;
+		ReturnStatus color_status;
+		unsigned int version;
+	};
+
 	// Abstract base class for Behavior Tree Nodes
 	class TreeNode
 	{
 	private:
-		// Node name
-		std::string name_;
+		// Node name, interned
+		std::string_view name_;
 
 	protected:
-		// The node state that must be treated in a thread-safe way
+		// The node state that must be treated in a thread-safe way.
+		// status, color status and version are packed in one lock-free word:
+		// bits 0-7 the status, bits 8-15 the color status, bits 32-63 the version.
 		bool is_state_updated_;
-		ReturnStatus status_;
-		ReturnStatus color_status_;
+		std::atomic<unsigned long long> state_;
 
-		std::mutex state_mutex_;
-		std::mutex color_state_mutex_;
-		std::condition_variable state_condition_variable_;
+		// Used only by the threads blocked in WaitForStatusChange(): they sleep on a
+		// wait slot shared with other nodes, so the node holds no mutex of its own
+		std::atomic<unsigned int> state_waiters_;
 		// Node type
 		NodeType type_;
 		//position and offset for horizontal positioning when drawing
 		float x_shift_, x_pose_;
 
 	public:
-		// The thread that will execute the node
-		std::thread thread_;
-
-		// Node semaphore to simulate the tick
-		// (and to synchronize fathers and children)
-		TickEngine tick_engine;
-
-		// The constructor and the distructor
+		// The constructor and the distructor.
+		// A control node does not delete its children: a whole tree is freed by DestroyTree().
 		TreeNode(std::string name);
-		~TreeNode();
+		virtual ~TreeNode();
 
 		// The method that is going to be executed when the node receive a tick
 		virtual BT::ReturnStatus Tick() = 0;
@@ -109,7 +121,7 @@ namespace BT
 		virtual int DrawType() = 0;
 		virtual void ResetColorState() = 0;
 		virtual int Depth() = 0;
-		bool is_halted();
+		virtual bool is_halted();
 
 		//Getters and setters
 		void set_x_pose(float x_pose);
@@ -121,8 +133,17 @@ namespace BT
 		ReturnStatus get_status();
 		void set_status(ReturnStatus new_status);
 
-		std::string get_name();
-		void set_name(std::string new_name);
+		// Reads status, color status and version together, without blocking
+		NodeState get_state();
+
+		// Every set_status() increments the status version and wakes up the
+		// threads blocked in WaitForStatusChange(), so there is no polling.
+		unsigned int get_status_version();
+		ReturnStatus WaitForStatusChange(unsigned int version);
+
+		// The name is interned: the view is null-terminated and never invalidated
+		std::string_view get_name();
+		void set_name(std::string_view new_name);
 
 		NodeType get_type();
 	};
@@ -148,17 +169,23 @@ namespace BT
 		~ControlNode();
 
 		// The method used to fill the child vector
-		void AddChild(TreeNode* child);
+		virtual void AddChild(TreeNode* child);
+		// Reserves the child vectors for the given number of children
+		void ReserveChildren(unsigned int children_number);
 
 		// The method used to know the number of children
 		unsigned int GetChildrenNumber();
-		std::vector<TreeNode*> GetChildren();
+		const std::vector<TreeNode*>& GetChildren();
 		// The method used to interrupt the execution of the node
 		void Halt();
 		void ResetColorState();
 		void HaltChildren(int i);
 		int Depth();
 
+		// The method used to route a tick to the child i and to get its state:
+		// actions are ticked through the executor, the other nodes directly
+		ReturnStatus TickChild(unsigned int i);
+
 		// Methods used to access the node state without the
 		// conditional waiting (only mutual access)
 		bool WriteState(ReturnStatus new_state);
@@ -176,8 +203,29 @@ namespace BT
 	};
 
 
+	// A condition can declare the inputs it reads with DependsOn(): its result is then
+	// reused by Evaluate() until the version of one of them changes.
+	// A condition without declared inputs is ticked every time.
 	class ConditionNode : public LeafNode
 	{
+	private:
+		// An input: a published blackboard entry, or a version counter
+		struct Dependency
+		{
+			Blackboard* blackboard;
+			unsigned int index;
+			const std::atomic<unsigned int>* counter;
+			unsigned int version;
+		};
+
+		std::vector<Dependency> dependencies_;
+		bool is_cache_valid_;
+		ReturnStatus cached_status_;
+		std::atomic<unsigned long long> cache_hits_;
+		std::atomic<unsigned long long> cache_misses_;
+
+		void AddBlackboardDependency(Blackboard* blackboard, unsigned int index);
+
 	public:
 		// Constructor
 		ConditionNode(std::string name);
@@ -186,6 +234,24 @@ namespace BT
 		// The method that is going to be executed by the thread
 		virtual BT::ReturnStatus Tick() = 0;
 
+		// The method used by the fathers: ticks the condition, or returns the cached
+		// result if none of the declared inputs has changed since the last tick
+		ReturnStatus Evaluate();
+
+		// Declares an input: an entry the condition reads from the blackboard snapshots,
+		// or a counter incremented whenever another input changes
+		template <typename T>
+		void DependsOn(Blackboard& blackboard, const BlackboardKey<T>& key)
+		{
+			AddBlackboardDependency(&blackboard, key.get_index());
+		}
+		void DependsOn(const std::atomic<unsigned int>& counter);
+
+		// Forces the next Evaluate() to tick
+		void InvalidateCache();
+		unsigned long long GetCacheHits();
+		unsigned long long GetCacheMisses();
+
 		// The method used to interrupt the execution of the node
 		void Halt();
 
@@ -196,24 +262,109 @@ namespace BT
 	};
 
 
+	class ActionNode;
+
+	// Tells a tick of an action that it has been halted.
+	// Tick() can poll stop_requested() or sleep with wait_for(), which returns as soon as
+	// the halt arrives: the time from the halt of the father to the stop is then bounded.
+	class StopToken
+	{
+	private:
+		ActionNode* node_;
+		unsigned int generation_;
+
+	public:
+		StopToken(ActionNode* node, unsigned int generation);
+		bool stop_requested() const;
+
+		// Sleeps for the duration or until the stop; returns true if stopped
+		bool wait_for(std::chrono::nanoseconds duration) const;
+	};
+
+
 	class ActionNode : public LeafNode
 	{
+	private:
+		// The executor that runs the ticks (nullptr means the default one)
+		Executor* executor_;
+
+		// Every tick sent has a generation: a halt stops the ticks up to halted_generation_,
+		// and only the tick of the current generation may publish its result
+		std::atomic<unsigned int> tick_generation_;
+		std::atomic<unsigned int> halted_generation_;
+		std::atomic<unsigned int> finished_generation_;
+		std::atomic<long long> halt_request_ns_;
+		std::chrono::nanoseconds halt_timeout_;
+
+		std::atomic<unsigned long long> halts_requested_;
+		std::atomic<unsigned long long> halts_completed_;
+		std::atomic<unsigned long long> halts_ignored_;
+		std::atomic<long long> halt_latency_sum_ns_;
+		std::atomic<long long> halt_latency_max_ns_;
+
+		// Ticks queued or running on the executor, abandoned ones included
+		std::atomic<unsigned int> pending_ticks_;
+
+		// Under the wait slot of the node: one tick runs at a time, and a tick sent while
+		// an abandoned one is still running is deferred until it returns
+		bool is_tick_in_flight_;
+		unsigned int deferred_generation_;
+
+		void SubmitTick(unsigned int generation);
+
+		friend class StopToken;
+
 	public:
 		// Constructor
 		ActionNode(std::string name);
+
+		// Waits for the ticks still queued or running. It cannot halt them (the derived
+		// part is already destroyed): the action must be halted before, see HaltTree().
 		~ActionNode();
 
-		// The method that is going to be executed by the thread
-		void WaitForTick();
+		// The method used by the fathers to send a tick: it sets the action
+		// RUNNING, schedules ExecuteTick() on the executor and returns immediately.
+		// If an abandoned tick is still running, the new one is scheduled when it returns.
+		void SendTick();
+
+		// The task that is going to be executed by the executor
+		void ExecuteTick(unsigned int generation);
 		virtual BT::ReturnStatus Tick() = 0;
 
-		// The method used to interrupt the execution of the node
+		// The method used to interrupt the execution of the node.
+		// It is called by RequestHalt(), together with the stop of the token.
 		virtual void Halt() = 0;
 
+		// The method used by the fathers to halt the running tick: it never blocks.
+		// The halted tick ends with the HALTED status, whatever Tick() returns.
+		void RequestHalt();
+
+		// Waits up to the halt timeout for the halted tick to return. If it does not,
+		// the tick is abandoned: its result will be dropped, the node goes HALTED at once
+		// and the halt is counted as ignored. Returns true if the tick has returned.
+		bool WaitForHalt();
+
+		// The token of the tick executed by the calling thread
+		StopToken get_stop_token();
+		bool is_halted();
+
+		// How long the fathers wait for a halted tick (100 ms by default): a tick still
+		// running after it is abandoned, 0 abandons it at once and nanoseconds::max() waits
+		// until it returns. The action never runs two ticks at once: see SendTick().
+		void set_halt_timeout(std::chrono::nanoseconds halt_timeout);
+		std::chrono::nanoseconds get_halt_timeout();
+		HaltStatistics GetHaltStatistics();
+
 		// Methods used to access the node state without the
 		// conditional waiting (only mutual access)
 		bool WriteState(ReturnStatus new_state);
 		int DrawType();
+
+		void set_executor(Executor* executor);
+		Executor* get_executor();
+
+		// Blocks until no tick of the action is queued or running
+		void WaitForTicks();
 	};
 
 
@@ -238,9 +389,51 @@ namespace BT
 		// The method that is going to be executed by the thread
 		BT::ReturnStatus Tick();
 	};
+
+	class ParallelNode : public ControlNode
+	{
+	private:
+		// Number of children that must succeed (fail) for the node to succeed (fail).
+		// 0 means all the children. Without children, the node succeeds if it needs all
+		// of them to succeed (SUCCEED_ON_ALL), and fails otherwise.
+		unsigned int success_threshold_;
+		unsigned int failure_threshold_;
+
+		// Status version of the actions ticked in the current tick
+		std::vector<unsigned int> dispatched_versions_;
+
+		void ResetChildrenStates();
+
+	public:
+		// Constructors: the thresholds are given by the policies or explicitly
+		ParallelNode(std::string name, SuccessPolicy success_policy = SUCCEED_ON_ALL, FailurePolicy failure_policy = FAIL_ON_ONE);
+		ParallelNode(std::string name, unsigned int success_threshold, unsigned int failure_threshold);
+		~ParallelNode();
+		int DrawType();
+		// The method that is going to be executed by the thread
+		BT::ReturnStatus Tick();
+		void Halt();
+
+		void set_success_threshold(unsigned int success_threshold);
+		unsigned int get_success_threshold();
+		void set_failure_threshold(unsigned int failure_threshold);
+		unsigned int get_failure_threshold();
+	};
+};
+
+
+namespace BT
+{
+	// Halts a tree and waits until none of its actions has a tick queued or running.
+	// A tick that ignores the halt is waited for too, so this can block as long as it runs.
+	void HaltTree(TreeNode* root);
+
+	// Halts a tree (HaltTree()) and deletes all its nodes, which must have been created with new
+	void DestroyTree(TreeNode* root);
 };
 
 
-void Execute(BT::ControlNode* root, int TickPeriod_milliseconds);
+// Ticks the root every period, forever; the ticking thread takes the policy if one is given
+void Execute(BT::ControlNode* root, int TickPeriod_milliseconds, const BT::ThreadPolicy* tick_policy = nullptr);
 
 
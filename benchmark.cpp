@@ -0,0 +1,372 @@
+// Micro- and macro-benchmarks of the tick path.
+// Usage: benchmark [output.json] [--quick]
+// Prints a summary and writes the results as JSON (bench_results.json by default).
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+#include"BTs.h"
+#include"BTExecutor.h"
+
+
+// Counts the heap traffic, to measure the memory per node.
+// The default operator delete releases with free(), so it is kept.
+static std::atomic<unsigned long long> allocated_bytes(0);
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// Deterministic condition: fails with the given probability (in percent)
+	class BenchCondition : public BT::ConditionNode
+	{
+	private:
+		unsigned int state_;
+		unsigned int failure_percent_;
+
+	public:
+		BenchCondition(std::string name, unsigned int seed, unsigned int failure_percent) : ConditionNode(name), state_(seed * 2654435761u + 1), failure_percent_(failure_percent) {}
+		BT::ReturnStatus Tick()
+		{
+			state_ = state_ * 1664525u + 1013904223u;
+			return ((state_ >> 8) % 100 < failure_percent_) ? BT::FAILURE : BT::SUCCESS;
+		}
+	};
+
+	// Action that completes immediately, or runs until halted
+	class BenchAction : public BT::ActionNode
+	{
+	private:
+		bool is_long_;
+
+	public:
+		BenchAction(std::string name, bool is_long = false) : ActionNode(name), is_long_(is_long) {}
+		BT::ReturnStatus Tick()
+		{
+			if (is_long_)
+			{
+				get_stop_token().wait_for(std::chrono::hours(1));
+			}
+			return BT::SUCCESS;
+		}
+		void Halt() {}
+	};
+
+	struct Result
+	{
+		std::string name;
+		unsigned int nodes;
+		unsigned int ticks;
+		double p50_us, p90_us, p99_us, max_us, mean_us;
+		double bytes_per_node;
+		double allocations_per_tick;
+		int threads;
+	};
+
+	int ThreadsNumber()
+	{
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 8, "Threads:") == 0)
+			{
+				return std::atoi(line.c_str() + 8);
+			}
+		}
+		return -1;
+	}
+
+	void Percentiles(std::vector<double>& samples, Result& result)
+	{
+		std::sort(samples.begin(), samples.end());
+		double sum = 0.0;
+		for (unsigned int i = 0; i < samples.size(); i++)
+		{
+			sum += samples[i];
+		}
+		result.ticks = samples.size();
+		result.p50_us = samples[samples.size() * 50 / 100];
+		result.p90_us = samples[samples.size() * 90 / 100];
+		result.p99_us = samples[samples.size() * 99 / 100];
+		result.max_us = samples.back();
+		result.mean_us = sum / samples.size();
+	}
+
+	double ElapsedUs(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::micro>(end - start).count();
+	}
+
+	unsigned int CountNodes(BT::TreeNode* node)
+	{
+		if (node->get_type() != BT::CONTROL_NODE)
+		{
+			return 1;
+		}
+		const std::vector<BT::TreeNode*>& children = static_cast<BT::ControlNode*>(node)->GetChildren();
+		unsigned int count = 1;
+		for (unsigned int i = 0; i < children.size(); i++)
+		{
+			count += CountNodes(children[i]);
+		}
+		return count;
+	}
+
+	// Tree builders
+	BT::ControlNode* WideSelector(unsigned int width)
+	{
+		BT::SelectorNode* root = new BT::SelectorNode("wide_selector");
+		for (unsigned int i = 0; i < width; i++)
+		{
+			// all fail but the last one, so every tick visits every child
+			root->AddChild(new BenchCondition("condition", i, (i + 1 == width) ? 0 : 100));
+		}
+		return root;
+	}
+	BT::ControlNode* DeepSequence(unsigned int depth)
+	{
+		BT::SequenceNode* root = new BT::SequenceNode("deep_sequence");
+		BT::SequenceNode* node = root;
+		for (unsigned int i = 1; i < depth; i++)
+		{
+			node->AddChild(new BenchCondition("condition", i, 0));
+			BT::SequenceNode* child = new BT::SequenceNode("sequence");
+			node->AddChild(child);
+			node = child;
+		}
+		node->AddChild(new BenchCondition("condition", depth, 0));
+		return root;
+	}
+	BT::ControlNode* ManyActions(unsigned int actions)
+	{
+		BT::ParallelNode* root = new BT::ParallelNode("many_actions", BT::SUCCEED_ON_ALL, BT::FAIL_ON_ONE);
+		for (unsigned int i = 0; i < actions; i++)
+		{
+			root->AddChild(new BenchAction("action"));
+		}
+		return root;
+	}
+	BT::TreeNode* Mixed(unsigned int depth, unsigned int& seed, unsigned int action_percent)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		if (depth == 0)
+		{
+			if ((seed >> 8) % 100 < action_percent)
+			{
+				return new BenchAction("action");
+			}
+			return new BenchCondition("condition", seed, 30);
+		}
+		BT::ControlNode* node;
+		if ((seed >> 12) % 2 == 0)
+		{
+			node = new BT::SequenceNode("sequence");
+		}
+		else
+		{
+			node = new BT::SelectorNode("selector");
+		}
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			node->AddChild(Mixed(depth - 1, seed, action_percent));
+		}
+		return node;
+	}
+
+	Result TickLatency(const std::string& name, BT::TreeNode* (*build)(unsigned int), unsigned int size, unsigned int ticks)
+	{
+		Result result = Result();
+		result.name = name;
+
+		unsigned long long bytes_before = allocated_bytes.load();
+		BT::TreeNode* root = build(size);
+		result.nodes = CountNodes(root);
+		result.bytes_per_node = (double)(allocated_bytes.load() - bytes_before) / result.nodes;
+
+		// warm up
+		for (unsigned int i = 0; i < ticks / 10 + 1; i++)
+		{
+			root->Tick();
+		}
+
+		std::vector<double> samples;
+		samples.reserve(ticks);
+		unsigned long long allocations_before = allocations.load();
+		for (unsigned int i = 0; i < ticks; i++)
+		{
+			Clock::time_point start = Clock::now();
+			root->Tick();
+			samples.push_back(ElapsedUs(start, Clock::now()));
+		}
+		result.allocations_per_tick = (double)(allocations.load() - allocations_before) / ticks;
+		Percentiles(samples, result);
+		result.threads = ThreadsNumber();
+		return result;
+	}
+
+	unsigned int mixed_action_percent = 0;
+	BT::TreeNode* BuildMixed(unsigned int depth)
+	{
+		unsigned int seed = 42;
+		return Mixed(depth, seed, mixed_action_percent);
+	}
+	BT::TreeNode* BuildWideSelector(unsigned int size)
+	{
+		return WideSelector(size);
+	}
+	BT::TreeNode* BuildDeepSequence(unsigned int size)
+	{
+		return DeepSequence(size);
+	}
+	BT::TreeNode* BuildManyActions(unsigned int size)
+	{
+		return ManyActions(size);
+	}
+
+	// Time from SendTick() until the father sees the final state of the action
+	Result DispatchRoundTrip(unsigned int rounds)
+	{
+		Result result = Result();
+		result.name = "dispatch_round_trip";
+		result.nodes = 1;
+
+		BenchAction action("action");
+		std::vector<double> samples;
+		samples.reserve(rounds);
+		for (unsigned int i = 0; i < rounds; i++)
+		{
+			Clock::time_point start = Clock::now();
+			unsigned int version = action.get_status_version();
+			action.SendTick();
+			BT::ReturnStatus status = action.WaitForStatusChange(version);
+			while (status != BT::SUCCESS)
+			{
+				version++;
+				status = action.WaitForStatusChange(version);
+			}
+			samples.push_back(ElapsedUs(start, Clock::now()));
+			action.set_status(BT::IDLE);
+		}
+		Percentiles(samples, result);
+		result.threads = ThreadsNumber();
+		return result;
+	}
+
+	// Time from a root Halt() over running actions until every halted tick has returned
+	Result HaltPropagation(unsigned int actions, unsigned int rounds)
+	{
+		Result result = Result();
+		result.name = "halt_propagation";
+
+		std::vector<BenchAction*> leaves;
+		BT::ParallelNode* root = new BT::ParallelNode("halt_root", BT::SUCCEED_ON_ALL, BT::FAIL_ON_ONE);
+		for (unsigned int i = 0; i < actions; i++)
+		{
+			leaves.push_back(new BenchAction("long_action", true));
+			root->AddChild(leaves.back());
+		}
+		result.nodes = CountNodes(root);
+
+		std::vector<double> samples;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			root->Tick();
+			Clock::time_point start = Clock::now();
+			root->Halt();
+			for (unsigned int i = 0; i < leaves.size(); i++)
+			{
+				while (leaves[i]->get_status() == BT::RUNNING)
+				{
+					std::this_thread::yield();
+				}
+			}
+			samples.push_back(ElapsedUs(start, Clock::now()));
+		}
+		Percentiles(samples, result);
+		result.threads = ThreadsNumber();
+		return result;
+	}
+
+	void WriteJson(const std::string& file_path, const std::vector<Result>& results)
+	{
+		FILE* file = std::fopen(file_path.c_str(), "w");
+		if (file == nullptr)
+		{
+			std::fprintf(stderr, "cannot write %s\n", file_path.c_str());
+			return;
+		}
+		std::fprintf(file, "{\n  \"workers\": %u,\n  \"results\": [\n", BT::GetDefaultExecutor()->GetWorkersNumber());
+		for (unsigned int i = 0; i < results.size(); i++)
+		{
+			const Result& r = results[i];
+			std::fprintf(file, "    {\"name\": \"%s\", \"nodes\": %u, \"samples\": %u, \"p50_us\": %.3f, \"p90_us\": %.3f, "
+				"\"p99_us\": %.3f, \"max_us\": %.3f, \"mean_us\": %.3f, \"bytes_per_node\": %.1f, "
+				"\"allocations_per_tick\": %.2f, \"threads\": %d}%s\n",
+				r.name.c_str(), r.nodes, r.ticks, r.p50_us, r.p90_us, r.p99_us, r.max_us, r.mean_us,
+				r.bytes_per_node, r.allocations_per_tick, r.threads, (i + 1 < results.size()) ? "," : "");
+		}
+		std::fprintf(file, "  ]\n}\n");
+		std::fclose(file);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string output = "bench_results.json";
+	bool is_quick = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--quick") == 0)
+		{
+			is_quick = true;
+		}
+		else
+		{
+			output = argv[i];
+		}
+	}
+	unsigned int ticks = is_quick ? 200 : 5000;
+
+	std::vector<Result> results;
+	results.push_back(TickLatency("wide_selector_1000", BuildWideSelector, 1000, ticks));
+	results.push_back(TickLatency("deep_sequence_500", BuildDeepSequence, 500, ticks));
+	results.push_back(TickLatency("many_actions_256", BuildManyActions, 256, ticks / 10));
+	mixed_action_percent = 0;
+	results.push_back(TickLatency("mixed_conditions_only_d6", BuildMixed, 6, ticks));
+	mixed_action_percent = 25;
+	results.push_back(TickLatency("mixed_25pct_actions_d6", BuildMixed, 6, ticks));
+	results.push_back(DispatchRoundTrip(ticks));
+	results.push_back(HaltPropagation(64, is_quick ? 10 : 100));
+
+	std::printf("%-28s %8s %10s %10s %10s %10s %12s %8s\n", "benchmark", "nodes", "p50_us", "p99_us", "max_us", "mean_us", "bytes/node", "threads");
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		std::printf("%-28s %8u %10.2f %10.2f %10.2f %10.2f %12.1f %8d\n",
+			r.name.c_str(), r.nodes, r.p50_us, r.p99_us, r.max_us, r.mean_us, r.bytes_per_node, r.threads);
+	}
+	WriteJson(output, results);
+	return 0;
+}
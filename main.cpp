@@ -2,25 +2,57 @@
 #include <iostream>
 #include<vector>
 #include<string>
+#include<cstdlib>
+#include<cstring>
 #include"BTs.h"
+#include"BTBlackboard.h"
+#include"BTLog.h"
+#include"BTThreading.h"
+#include"BTClock.h"
 using namespace std;
 
-vector<double> path;
-double speed(10);
+// Waypoints written by the action and read by the control loop
+struct Path
+{
+	double waypoints[16];
+	int size;
+};
+
+// State shared between the tree and the control loop
+BT::Blackboard blackboard;
+BT::BlackboardKey<Path> path_key = blackboard.Declare<Path>("path", Path());
+BT::BlackboardKey<double> speed_key = blackboard.Declare<double>("speed", 10);
+
+// Placement of the control loop: --control-cpu <n> (repeatable) and --control-priority <1-99>
+// give it its own core and let it preempt the tree; nothing is changed by default
+BT::ThreadPolicy control_policy;
 
 void control() {
+	BT::ThreadPolicyResult result = BT::ApplyThreadPolicy(control_policy);
+	if (!result.is_applied()) {
+		BT_LOG_ERROR("control", "thread policy not applied (error %d): %s", result.error, result.message.c_str());
+	}
+
 	while (true) {
+		double speed;
+		int path_size;
+		{
+			// one consistent view of the blackboard, released before sleeping
+			BT::Blackboard::Snapshot snapshot = blackboard.GetSnapshot();
+			speed = snapshot.Get(speed_key);
+			path_size = snapshot.Get(path_key).size;
+		}
 		double curSpeed = 15;
 		double steering;
-		std::cout << "速度差为:" << curSpeed - speed << std::endl;
-		if (path.size() > 0) {
+		BT_LOG_INFO("control", "速度差为:%g", curSpeed - speed);
+		if (path_size > 0) {
 			steering = 15;
-			std::cout << "转向设置为：" << steering << std::endl;
+			BT_LOG_INFO("control", "转向设置为：%g", steering);
 		}
 		else
-			std::cout << "转向设置为：" << 0 << std::endl;
-		std::this_thread::sleep_for(std::chrono::milliseconds(50));
-		std::cout << "控制结束:" << std::endl;
+			BT_LOG_INFO("control", "转向设置为：%d", 0);
+		BT::GetDefaultClock()->SleepFor(std::chrono::milliseconds(50));
+		BT_LOG_INFO("control", "控制结束:");
 	}
 }
 
@@ -48,16 +80,24 @@ MyAction::MyAction(std::string name) : ActionNode::ActionNode(name) {}
 
 BT::ReturnStatus MyAction::Tick()
 {
-	if(speed<=10)
-		std::cout << "The Action is doing some operations" << std::endl;
-	path.push_back(10);
-	path.push_back(20);
-	std::this_thread::sleep_for(std::chrono::seconds(5));
-	if (is_halted())
+	{
+		BT::Blackboard::Snapshot snapshot = blackboard.GetSnapshot();
+		if(snapshot.Get(speed_key)<=10)
+			BT_LOG_INFO(get_name().data(), "The Action is doing some operations");
+		Path path = snapshot.Get(path_key);
+		if (path.size + 2 <= 16)
+		{
+			path.waypoints[path.size++] = 10;
+			path.waypoints[path.size++] = 20;
+		}
+		blackboard.Set(path_key, path);
+	}
+	// returns as soon as the action is halted
+	if (get_stop_token().wait_for(std::chrono::seconds(5)))
 	{
 		return BT::HALTED;
 	}
-	std::cout << "The Action has succeeded" << std::endl;
+	BT_LOG_INFO(get_name().data(), "The Action has succeeded");
 	return BT::SUCCESS;
 }
 
@@ -67,6 +107,14 @@ void MyAction::Halt() {}
 
 int main(int argc, char *argv[])
 {
+	control_policy.name = "bt-control";
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "--control-cpu") == 0)
+			control_policy.cpus.push_back(std::atoi(argv[i + 1]));
+		else if (std::strcmp(argv[i], "--control-priority") == 0)
+			control_policy.priority = std::atoi(argv[i + 1]);
+	}
+
 	//std::thread control(control);
 
 	//BT::SequenceNode* root = new BT::SequenceNode("Sequence");
@@ -0,0 +1,216 @@
+// Regression tests of the engine.
+// Usage: test [name]
+// Runs all the tests (or the named one) and returns 1 if one of them fails.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include"BTs.h"
+#include"BTExecutor.h"
+#include"BTDecorator.h"
+#include"BTLoader.h"
+
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	int failures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+	double ElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+
+	// Action that ignores the halts: it always runs for its whole duration
+	class StubbornAction : public BT::ActionNode
+	{
+	private:
+		std::chrono::milliseconds duration_;
+
+	public:
+		std::atomic<int> running_ticks;
+		std::atomic<int> max_running_ticks;
+		std::atomic<int> ticks;
+
+		StubbornAction(std::string name, std::chrono::milliseconds duration) : ActionNode(name), duration_(duration), running_ticks(0), max_running_ticks(0), ticks(0) {}
+		BT::ReturnStatus Tick()
+		{
+			ticks++;
+			int running = ++running_ticks;
+			int max_running = max_running_ticks.load();
+			while (running > max_running && !max_running_ticks.compare_exchange_weak(max_running, running)) {}
+			std::this_thread::sleep_for(duration_);
+			running_ticks--;
+			return BT::SUCCESS;
+		}
+		void Halt() {}
+	};
+
+	// A halt of an action that ignores it returns within the halt timeout, and so does the
+	// next tick of the father: the new tick waits for the abandoned one on the executor
+	void TestHaltIgnored()
+	{
+		BT::ThreadPool pool(2);
+		StubbornAction action("stubborn", std::chrono::milliseconds(300));
+		action.set_executor(&pool);
+		action.set_halt_timeout(std::chrono::milliseconds(50));
+		BT::SequenceNode root("root");
+		root.AddChild(&action);
+
+		CHECK(root.Tick() == BT::RUNNING);
+		Clock::time_point start = Clock::now();
+		root.Halt();
+		CHECK(ElapsedMs(start) < 150);
+		CHECK(action.get_status() == BT::HALTED);
+		CHECK(action.GetHaltStatistics().ignored == 1);
+
+		start = Clock::now();
+		CHECK(root.Tick() == BT::RUNNING);
+		CHECK(ElapsedMs(start) < 50);
+
+		// the deferred tick runs after the abandoned one, never beside it
+		while (action.get_status() == BT::RUNNING)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		CHECK(action.get_status() == BT::SUCCESS);
+		CHECK(action.ticks.load() == 2);
+		CHECK(action.max_running_ticks.load() == 1);
+		action.WaitForTicks();
+	}
+
+
+	// A timeout takes the result of a child that has finished just before the deadline,
+	// and resets a child it halts so that the next tick starts it again
+	void TestTimeoutResult()
+	{
+		BT::ThreadPool pool(2);
+		StubbornAction action("action", std::chrono::milliseconds(40));
+		action.set_executor(&pool);
+		BT::TimeoutNode timeout("timeout", std::chrono::milliseconds(60));
+		timeout.AddChild(&action);
+
+		CHECK(timeout.Tick() == BT::RUNNING);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		CHECK(timeout.Tick() == BT::SUCCESS);
+		CHECK(action.get_status() == BT::IDLE);
+		CHECK(timeout.Tick() == BT::RUNNING);
+		CHECK(action.ticks.load() == 2);
+		action.WaitForTicks();
+
+		StubbornAction slow_action("slow_action", std::chrono::milliseconds(150));
+		slow_action.set_executor(&pool);
+		slow_action.set_halt_timeout(std::chrono::milliseconds(10));
+		BT::TimeoutNode slow_timeout("slow_timeout", std::chrono::milliseconds(30));
+		slow_timeout.AddChild(&slow_action);
+
+		CHECK(slow_timeout.Tick() == BT::RUNNING);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		CHECK(slow_timeout.Tick() == BT::FAILURE);
+		CHECK(slow_action.get_status() == BT::IDLE);
+		CHECK(slow_timeout.Tick() == BT::RUNNING);
+		slow_action.WaitForTicks();
+		CHECK(slow_action.ticks.load() == 2);
+	}
+
+
+	// Condition that counts its instances
+	class CountedCondition : public BT::ConditionNode
+	{
+	public:
+		static int instances;
+
+		CountedCondition(std::string name) : ConditionNode(name) { instances++; }
+		~CountedCondition() { instances--; }
+		BT::ReturnStatus Tick() { return BT::SUCCESS; }
+	};
+	int CountedCondition::instances = 0;
+
+	// A malformed image that gives two children to a decorator: the loading fails and frees
+	// every node created, the one the decorator has refused included
+	void TestLoadDecoratorChildren()
+	{
+		BT::NodeFactory factory;
+		factory.Register<CountedCondition>("Counted");
+		std::vector<char> image = BT::CompileTextTree("Sequence root\n  Counted first\n  Inverter invert\n    Counted a\n    Counted b\n");
+
+		bool is_thrown = false;
+		try
+		{
+			BT::LoadBinaryTree(image.data(), image.size(), factory);
+		}
+		catch (const std::logic_error&)
+		{
+			is_thrown = true;
+		}
+		CHECK(is_thrown);
+		CHECK(CountedCondition::instances == 0);
+	}
+
+
+	// A parallel node without children succeeds on all of them, and fails on one of them
+	void TestEmptyParallel()
+	{
+		BT::ParallelNode all("all", BT::SUCCEED_ON_ALL, BT::FAIL_ON_ONE);
+		CHECK(all.Tick() == BT::SUCCESS);
+		BT::ParallelNode all_all("all_all", BT::SUCCEED_ON_ALL, BT::FAIL_ON_ALL);
+		CHECK(all_all.Tick() == BT::SUCCESS);
+		BT::ParallelNode one("one", BT::SUCCEED_ON_ONE, BT::FAIL_ON_ONE);
+		CHECK(one.Tick() == BT::FAILURE);
+		BT::ParallelNode two("two", 2, 1);
+		CHECK(two.Tick() == BT::FAILURE);
+	}
+
+
+	struct Test
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	const Test tests[] =
+	{
+		{ "halt_ignored", TestHaltIgnored },
+		{ "timeout_result", TestTimeoutResult },
+		{ "load_decorator_children", TestLoadDecoratorChildren },
+		{ "empty_parallel", TestEmptyParallel },
+	};
+}
+
+
+int main(int argc, char* argv[])
+{
+	int failed_tests = 0;
+	for (unsigned int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+	{
+		if (argc > 1 && std::strcmp(argv[1], tests[i].name) != 0)
+		{
+			continue;
+		}
+		int previous_failures = failures;
+		tests[i].run();
+		bool is_passed = (failures == previous_failures);
+		std::printf("%-28s %s\n", tests[i].name, is_passed ? "ok" : "FAILED");
+		if (!is_passed)
+		{
+			failed_tests++;
+		}
+	}
+	return failed_tests > 0 ? 1 : 0;
+}